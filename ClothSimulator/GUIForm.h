@@ -473,7 +473,7 @@ namespace GUI
             index = 0;
 
             CreateSpinBox(m_vertRows, path+"vertrows.png",
-                "Change the number of vertex rows", index++, 2.0, 4.0, 30.0,
+                "Change the number of vertex rows", index++, 2.0, 5.0, 29.0,
                 gcnew System::EventHandler(this, &GUIForm::VertexRowsChanged));
 
             CreateSpinBox(m_iterations, path+"iterations.png", 
@@ -0,0 +1,38 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - batchmain.cpp
+////////////////////////////////////////////////////////////////////////////////////////
+
+#include "batchrunner.h"
+#include <iostream>
+#include <fstream>
+
+int main(int argc, char* argv[])
+{
+    if(argc < 2)
+    {
+        std::cerr << "Usage: ClothBatch <sweep file> [results csv]" << std::endl;
+        return 1;
+    }
+
+    BatchRunner runner;
+    if(!runner.LoadSweep(argv[1], std::cerr))
+    {
+        return 1;
+    }
+
+    if(argc > 2)
+    {
+        std::ofstream file(argv[2]);
+        if(!file.is_open())
+        {
+            std::cerr << "Could not open results file " << argv[2] << std::endl;
+            return 1;
+        }
+        runner.Run(file, std::cout, std::cerr);
+    }
+    else
+    {
+        runner.Run(std::cout, std::cerr, std::cerr);
+    }
+    return 0;
+}
@@ -0,0 +1,455 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - batchrunner.cpp
+////////////////////////////////////////////////////////////////////////////////////////
+
+#include "batchrunner.h"
+#include "batchsimulation.h"
+#include "cloth.h"
+#include "scene.h"
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <cmath>
+#include <algorithm>
+
+namespace
+{
+    const float PHYSICS_STEP = 1.0f / 60.0f; ///< Time for a single physics step
+    const int STEPS = 600;                   ///< Initial physics steps for each run
+
+    /**
+    * Settings that can be swept and the value used when not given
+    */
+    const char* DEFAULT_PARAMETERS[][2] =
+    {
+        { "rows", "21" },
+        { "level", "0" },
+        { "mesh", "none" },
+        { "spacing", "0.75" },
+        { "iterations", "2" },
+        { "timestep", "0.45" },
+        { "solver", "Parallel" },
+        { "adaptive", "0" },
+        { "tearing", "0" },
+        { "attachments", "0" },
+        { "wind", "0" },
+        { "object", "none" },
+        { "pinned", "1" },
+        { "hem", "1" },
+        { "threads", "1" },
+        { "deterministic", "0" }
+    };
+
+    const std::string OBJECT_NAMES[Scene::MAX_OBJECT] =
+    {
+        "box",
+        "sphere",
+        "cylinder"
+    };
+
+    /**
+    * Converts the whole of the text to a value
+    * @param text The text to convert
+    * @param value Filled with the converted value
+    * @return whether the conversion succeeded
+    */
+    template<typename T> bool ParseValue(const std::string& text, T& value)
+    {
+        std::istringstream stream(text);
+        return (stream >> value) && stream.eof();
+    }
+}
+
+BatchRunner::BatchRunner() :
+    m_runs(1),
+    m_steps(STEPS),
+    m_jobs(0)
+{
+    for(const auto& parameter : DEFAULT_PARAMETERS)
+    {
+        Parameter defaultParameter;
+        defaultParameter.name = parameter[0];
+        defaultParameter.values.push_back(parameter[1]);
+        m_parameters.push_back(defaultParameter);
+    }
+}
+
+bool BatchRunner::LoadSweep(const std::string& path, std::ostream& errors)
+{
+    std::ifstream file(path);
+    if(!file.is_open())
+    {
+        errors << "Could not open sweep file " << path << std::endl;
+        return false;
+    }
+
+    bool success = true;
+    int lineNumber = 0;
+    std::string line;
+
+    while(std::getline(file, line))
+    {
+        ++lineNumber;
+        std::istringstream stream(line);
+        std::string name;
+        if(!(stream >> name) || name[0] == '#')
+        {
+            continue;
+        }
+
+        std::vector<std::string> values;
+        std::string value;
+        while(stream >> value)
+        {
+            values.push_back(value);
+        }
+
+        if(values.empty())
+        {
+            errors << "Line " << lineNumber << ": no values for " << name << std::endl;
+            success = false;
+        }
+        else if(name == "steps" || name == "jobs")
+        {
+            // Settings for the whole sweep only take a single value
+            int& setting = name == "steps" ? m_steps : m_jobs;
+            if(values.size() != 1 || !ParseValue(values[0], setting) || setting < 0)
+            {
+                errors << "Line " << lineNumber << ": " << name
+                    << " requires a single non-negative number" << std::endl;
+                success = false;
+            }
+        }
+        else
+        {
+            auto parameter = std::find_if(m_parameters.begin(), m_parameters.end(),
+                [&name](const Parameter& parameter){ return parameter.name == name; });
+
+            if(parameter == m_parameters.end())
+            {
+                errors << "Line " << lineNumber << ": unknown setting " << name << std::endl;
+                success = false;
+                continue;
+            }
+
+            Settings settings = GetSettings(0);
+            for(const std::string& value : values)
+            {
+                if(!SetParameter(settings, name, value))
+                {
+                    errors << "Line " << lineNumber << ": invalid value "
+                        << value << " for " << name << std::endl;
+                    success = false;
+                }
+            }
+            parameter->values = values;
+        }
+    }
+
+    m_runs = 1;
+    for(const Parameter& parameter : m_parameters)
+    {
+        m_runs *= static_cast<int>(parameter.values.size());
+    }
+    return success;
+}
+
+bool BatchRunner::SetParameter(Settings& settings,
+                               const std::string& name,
+                               const std::string& value) const
+{
+    if(name == "rows")
+    {
+        return ParseValue(value, settings.rows) && settings.rows > 1;
+    }
+    else if(name == "level")
+    {
+        return ParseValue(value, settings.level) && settings.level >= 0;
+    }
+    else if(name == "mesh")
+    {
+        settings.mesh = value == "none" ? std::string() : value;
+        return settings.mesh.empty() || std::ifstream(settings.mesh).is_open();
+    }
+    else if(name == "spacing")
+    {
+        return ParseValue(value, settings.spacing) && settings.spacing > 0.0f;
+    }
+    else if(name == "iterations")
+    {
+        return ParseValue(value, settings.iterations) && settings.iterations > 0;
+    }
+    else if(name == "timestep")
+    {
+        return ParseValue(value, settings.timestep) && settings.timestep > 0.0f;
+    }
+    else if(name == "adaptive")
+    {
+        return ParseValue(value, settings.adaptive);
+    }
+    else if(name == "tearing")
+    {
+        return ParseValue(value, settings.tearing);
+    }
+    else if(name == "attachments")
+    {
+        return ParseValue(value, settings.attachments);
+    }
+    else if(name == "wind")
+    {
+        return ParseValue(value, settings.wind);
+    }
+    else if(name == "pinned")
+    {
+        return ParseValue(value, settings.pinned);
+    }
+    else if(name == "hem")
+    {
+        return ParseValue(value, settings.hem) && settings.hem > 0.0f;
+    }
+    else if(name == "threads")
+    {
+        return ParseValue(value, settings.threads) && settings.threads >= 0;
+    }
+    else if(name == "deterministic")
+    {
+        return ParseValue(value, settings.deterministic);
+    }
+    else if(name == "solver")
+    {
+        for(int solver = 0; solver < Cloth::MAX_SOLVERS; ++solver)
+        {
+            if(value == Cloth::GetSolverName(static_cast<Cloth::Solver>(solver)))
+            {
+                settings.solver = solver;
+                return true;
+            }
+        }
+    }
+    else if(name == "object")
+    {
+        if(value == "none")
+        {
+            settings.object = NO_INDEX;
+            return true;
+        }
+
+        for(int object = 0; object < Scene::MAX_OBJECT; ++object)
+        {
+            if(value == OBJECT_NAMES[object])
+            {
+                settings.object = object;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+const std::string& BatchRunner::GetValue(int run, int index) const
+{
+    // The last setting changes the fastest between runs
+    for(int i = static_cast<int>(m_parameters.size())-1; i > index; --i)
+    {
+        run /= static_cast<int>(m_parameters[i].values.size());
+    }
+
+    const auto& values = m_parameters[index].values;
+    return values[run % static_cast<int>(values.size())];
+}
+
+BatchRunner::Settings BatchRunner::GetSettings(int run) const
+{
+    Settings settings;
+    for(int i = 0; i < static_cast<int>(m_parameters.size()); ++i)
+    {
+        SetParameter(settings, m_parameters[i].name, GetValue(run, i));
+    }
+    return settings;
+}
+
+BatchRunner::Result BatchRunner::Simulate(const Settings& settings) const
+{
+    Result result = {};
+    BatchSimulation simulation;
+    if(!simulation.CreateSimulation(settings.threads, settings.deterministic, result.error))
+    {
+        return result;
+    }
+    result.created = true;
+
+    Cloth& cloth = simulation.GetCloth();
+    cloth.SetVertexRows(settings.rows);
+    if(!settings.mesh.empty() && !cloth.LoadMesh(settings.mesh, result.error))
+    {
+        result.created = false;
+        return result;
+    }
+
+    cloth.SetSpacing(settings.spacing);
+    cloth.SetSimulationLevel(settings.level);
+    cloth.SetIterations(settings.iterations);
+    cloth.SetTimeStep(settings.timestep);
+    cloth.SetSolver(static_cast<Cloth::Solver>(settings.solver));
+
+    if(settings.adaptive)
+    {
+        cloth.ToggleAdaptiveIterations();
+    }
+
+    if(settings.tearing)
+    {
+        cloth.ToggleTearing();
+    }
+
+    if(settings.attachments)
+    {
+        cloth.ToggleAttachments();
+    }
+
+    if(settings.wind)
+    {
+        cloth.ToggleWind();
+    }
+
+    // Pin the particles along the lowest x edge which for the grid is the first
+    // row and weight the particles along the highest x edge to form a hem
+    const auto& initialPositions = cloth.GetParticles().positions;
+    float minX = initialPositions[0].x;
+    float maxX = initialPositions[0].x;
+    for(const D3DXVECTOR3& position : initialPositions)
+    {
+        minX = min(minX, position.x);
+        maxX = max(maxX, position.x);
+    }
+
+    for(unsigned int i = 0; i < initialPositions.size(); ++i)
+    {
+        if(settings.pinned && initialPositions[i].x <= minX + settings.spacing * 0.5f)
+        {
+            cloth.SelectParticle(i);
+        }
+        else if(initialPositions[i].x >= maxX - settings.spacing * 0.5f)
+        {
+            cloth.SetParticleMass(i, cloth.GetParticles().masses[i] * settings.hem);
+        }
+    }
+
+    if(settings.object != NO_INDEX)
+    {
+        simulation.GetScene().AddObject(static_cast<Scene::Object>(settings.object));
+    }
+
+    cloth.SetSimulation(true);
+
+    LARGE_INTEGER frequency, start, end;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&start);
+
+    std::vector<D3DXVECTOR3> previousPositions;
+    for(int step = 0; step < m_steps; ++step)
+    {
+        if(step == m_steps-1)
+        {
+            previousPositions = cloth.GetParticles().positions;
+        }
+        simulation.Update(PHYSICS_STEP);
+    }
+
+    QueryPerformanceCounter(&end);
+    result.totalTime = 1000.0 * static_cast<double>(end.QuadPart - start.QuadPart) /
+        static_cast<double>(frequency.QuadPart);
+
+    // Motion left after the last step shows how well the cloth has settled
+    const auto& positions = cloth.GetParticles().positions;
+    result.stable = true;
+    for(unsigned int i = 0; i < previousPositions.size(); ++i)
+    {
+        const D3DXVECTOR3& position = positions[i];
+        result.stable &= std::isfinite(position.x) &&
+            std::isfinite(position.y) && std::isfinite(position.z);
+
+        const D3DXVECTOR3 motion = position - previousPositions[i];
+        result.maxMotion = max(result.maxMotion, D3DXVec3Length(&motion));
+    }
+
+    result.maxError = cloth.MeasureStretchError(result.rmsError);
+    result.stable &= std::isfinite(result.maxError);
+    result.stateHash = cloth.GetParticles().GetStateHash();
+    return result;
+}
+
+void BatchRunner::Run(std::ostream& output, std::ostream& progress, std::ostream& errors)
+{
+    std::vector<Result> results(m_runs);
+    std::atomic<int> nextRun(0);
+    std::mutex progressMutex;
+
+    // Each run creates its own device and scene so they share no state
+    auto simulateRuns = [&]()
+    {
+        for(int run = nextRun++; run < m_runs; run = nextRun++)
+        {
+            results[run] = Simulate(GetSettings(run));
+
+            std::lock_guard<std::mutex> lock(progressMutex);
+            progress << "Run " << run+1 << " of " << m_runs
+                << (results[run].created ? " finished" : " failed") << std::endl;
+
+            if(!results[run].error.empty())
+            {
+                errors << "Run " << run+1 << ": " << results[run].error << std::endl;
+            }
+        }
+    };
+
+    int jobs = m_jobs > 0 ? m_jobs : static_cast<int>(std::thread::hardware_concurrency());
+    jobs = jobs < m_runs ? jobs : m_runs;
+
+    std::vector<std::thread> workers;
+    for(int i = 1; i < jobs; ++i)
+    {
+        workers.push_back(std::thread(simulateRuns));
+    }
+    simulateRuns();
+
+    for(std::thread& worker : workers)
+    {
+        worker.join();
+    }
+
+    output << "run";
+    for(const Parameter& parameter : m_parameters)
+    {
+        output << "," << parameter.name;
+    }
+    output << ",steps,total_ms,step_ms,max_stretch,rms_stretch,max_motion,stable,state_hash" << std::endl;
+
+    for(int run = 0; run < m_runs; ++run)
+    {
+        const Result& result = results[run];
+        output << run+1;
+        for(int i = 0; i < static_cast<int>(m_parameters.size()); ++i)
+        {
+            output << "," << GetValue(run, i);
+        }
+
+        output << "," << m_steps;
+        if(result.created)
+        {
+            output << "," << result.totalTime
+                << "," << (m_steps > 0 ? result.totalTime / m_steps : 0.0)
+                << "," << result.maxError
+                << "," << result.rmsError
+                << "," << result.maxMotion
+                << "," << (result.stable ? 1 : 0)
+                << "," << result.stateHash << std::endl;
+        }
+        else
+        {
+            output << ",,,,,,0," << std::endl;
+        }
+    }
+}
@@ -0,0 +1,123 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - batchrunner.h
+////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include <string>
+#include <vector>
+#include <ostream>
+
+/**
+* Runs every combination of cloth settings from a sweep file
+* without rendering and reports the cost and quality of each
+*/
+class BatchRunner
+{
+public:
+
+    /**
+    * Constructor
+    */
+    BatchRunner();
+
+    /**
+    * Loads the sweep file. Each line holds a setting followed
+    * by the values to try for it; lines starting with # are ignored
+    * @param path The path to the sweep file
+    * @param errors Stream to write any problems with the file to
+    * @return whether loading succeeded
+    */
+    bool LoadSweep(const std::string& path, std::ostream& errors);
+
+    /**
+    * Runs all combinations of the settings across threads
+    * @param output Stream to write the results to as csv
+    * @param progress Stream to write each finished run to
+    * @param errors Stream to write why any run failed to
+    */
+    void Run(std::ostream& output, std::ostream& progress, std::ostream& errors);
+
+private:
+
+    /**
+    * Values to try for a setting of the cloth or scene
+    */
+    struct Parameter
+    {
+        std::string name;                 ///< Name of the setting
+        std::vector<std::string> values;  ///< Values to try for the setting
+    };
+
+    /**
+    * Settings for a single run
+    */
+    struct Settings
+    {
+        int rows;            ///< Amount of vertex rows for the cloth
+        int level;           ///< Times the simulated rows are halved from the rendered rows
+        std::string mesh;    ///< Path of a mesh to use instead of the grid or empty for none
+        float spacing;       ///< Spacing between vertices
+        int iterations;      ///< Iterations of the spring solver
+        float timestep;      ///< Cloth timestep
+        int solver;          ///< Method for solving the springs
+        bool adaptive;       ///< Whether to relax the springs until within tolerance
+        bool tearing;        ///< Whether overstretched springs tear the cloth
+        bool attachments;    ///< Whether particles are tethered to the closest pinned particle
+        bool wind;           ///< Whether the wind blows on the cloth
+        int object;          ///< Scene object under the cloth or NO_INDEX for none
+        bool pinned;         ///< Whether the first row or edge of the cloth is pinned
+        float hem;           ///< Mass scale of the particles along the edge opposite the pins
+        int threads;         ///< Threads used for the cloth or zero for all cores
+        bool deterministic;  ///< Whether results must not depend on the thread count
+    };
+
+    /**
+    * Timing and quality of a single run
+    */
+    struct Result
+    {
+        bool created;        ///< Whether the simulation could be created
+        bool stable;         ///< Whether all particles remained finite
+        double totalTime;    ///< Time taken for all steps in milliseconds
+        float maxError;      ///< Largest relative spring error after the last step
+        float rmsError;      ///< Root mean square relative spring error after the last step
+        float maxMotion;     ///< Largest distance a particle moved in the last step
+        unsigned long long stateHash; ///< Hash of the particles after the last step
+        std::string error;   ///< Why the simulation could not be created
+    };
+
+    /**
+    * Sets a value of the settings from the sweep
+    * @param settings The settings to change
+    * @param name The name of the setting
+    * @param value The value for the setting
+    * @return whether the setting and value were recognised
+    */
+    bool SetParameter(Settings& settings,
+        const std::string& name, const std::string& value) const;
+
+    /**
+    * @param run The index of the run
+    * @return the settings for the run
+    */
+    Settings GetSettings(int run) const;
+
+    /**
+    * @param run The index of the run
+    * @param index The index of the parameter
+    * @return the value of the parameter used for the run
+    */
+    const std::string& GetValue(int run, int index) const;
+
+    /**
+    * Simulates a single run
+    * @param settings The settings for the run
+    * @return the timing and quality of the run
+    */
+    Result Simulate(const Settings& settings) const;
+
+    std::vector<Parameter> m_parameters;  ///< Settings to sweep in order of the csv
+    int m_runs;                           ///< Total combinations of the settings
+    int m_steps;                          ///< Physics steps to simulate each run
+    int m_jobs;                           ///< Runs to simulate at once or zero for all cores
+};
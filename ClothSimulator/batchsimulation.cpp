@@ -0,0 +1,143 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - batchsimulation.cpp
+////////////////////////////////////////////////////////////////////////////////////////
+
+#include "batchsimulation.h"
+#include "cloth.h"
+#include "shader.h"
+#include "scene.h"
+#include "octree.h"
+#include "collisionsolver.h"
+#include "threadpool.h"
+#include <sstream>
+
+BatchSimulation::BatchSimulation() :
+    m_d3d(nullptr),
+    m_d3ddev(nullptr)
+{
+}
+
+BatchSimulation::~BatchSimulation()
+{
+    // Release all meshes before the device that created them
+    m_octree.reset();
+    m_scene.reset();
+    m_cloth.reset();
+    m_solver.reset();
+    m_diagnostics.reset();
+    m_shader.reset();
+
+    if(m_d3ddev)
+    {
+        m_d3ddev->Release();
+    }
+
+    if(m_d3d)
+    {
+        m_d3d->Release();
+    }
+}
+
+bool BatchSimulation::CreateDevice(std::string& errorBuffer)
+{
+    m_d3d = Direct3DCreate9(D3D_SDK_VERSION);
+    if(!m_d3d)
+    {
+        errorBuffer = "Direct3D 9 could not be created";
+        return false;
+    }
+
+    // Nothing is presented so the smallest windowed back buffer is used
+    D3DPRESENT_PARAMETERS d3dpp;
+    ZeroMemory(&d3dpp, sizeof(d3dpp));
+    d3dpp.hDeviceWindow = GetDesktopWindow();
+    d3dpp.Windowed = true;
+    d3dpp.SwapEffect = D3DSWAPEFFECT_DISCARD;
+    d3dpp.BackBufferFormat = D3DFMT_UNKNOWN;
+    d3dpp.BackBufferWidth = 1;
+    d3dpp.BackBufferHeight = 1;
+
+    // Preserve the FPU precision as the device is created on a worker thread
+    const HRESULT result = m_d3d->CreateDevice(D3DADAPTER_DEFAULT, D3DDEVTYPE_NULLREF,
+        d3dpp.hDeviceWindow, D3DCREATE_SOFTWARE_VERTEXPROCESSING |
+        D3DCREATE_FPU_PRESERVE, &d3dpp, &m_d3ddev);
+
+    if(FAILED(result))
+    {
+        // The null reference device is only available with the reference rasterizer
+        std::ostringstream stream;
+        stream << "Null reference device could not be created (HRESULT 0x" 
+            << std::hex << static_cast<unsigned long>(result) 
+            << "), the DirectX SDK reference rasterizer d3dref9.dll is required";
+        errorBuffer = stream.str();
+        return false;
+    }
+    return true;
+}
+
+bool BatchSimulation::CreateSimulation(int threads, bool deterministic, std::string& errorBuffer)
+{
+    if(!CreateDevice(errorBuffer))
+    {
+        return false;
+    }
+
+    m_diagnostics.reset(new Diagnostic());
+    m_shader.reset(new ShaderManager());
+    m_threadpool.reset(new ThreadPool(threads));
+    m_threadpool->SetDeterministic(deterministic);
+
+    // Create the engine callbacks
+    EnginePtr engine(new Engine());
+    engine->device = [this](){ return m_d3ddev; };
+    engine->diagnostic = [this](){ return m_diagnostics.get(); };
+    engine->octree = [this](){ return m_octree.get(); };
+    engine->threadpool = [this](){ return m_threadpool.get(); };
+    engine->sendLightsToShader = [](LPD3DXEFFECT){};
+
+    engine->getShader = std::bind(&ShaderManager::GetShader,
+        m_shader.get(), std::placeholders::_1);
+
+    // Meshes still require their shaders to be created
+    if(!m_shader->Inititalise(m_d3ddev, errorBuffer))
+    {
+        return false;
+    }
+
+    m_diagnostics->Initialise(m_d3ddev,
+        m_shader->GetShader(ShaderManager::BOUNDS_SHADER));
+
+    Octree* octree = new Octree(engine);
+    octree->BuildInitialTree();
+    m_octree.reset(octree);
+
+    m_solver.reset(new CollisionSolver(engine));
+    m_scene.reset(new Scene(engine, m_solver));
+    m_cloth.reset(new Cloth(engine, D3DXVECTOR3(0.0f, 0.0f, 0.0f)));
+    m_solver->AddCloth(m_cloth);
+
+    octree->SetIteratorFunction(std::bind(&CollisionSolver::SolveObjectCollision,
+        m_solver.get(), std::placeholders::_1, std::placeholders::_2));
+
+    return true;
+}
+
+void BatchSimulation::Update(float deltatime)
+{
+    m_cloth->PreCollisionUpdate(deltatime);
+    m_scene->PreCollisionUpdate(deltatime);
+
+    m_scene->SolveCollisions();
+    m_cloth->PostCollisionUpdate();
+    m_scene->PostCollisionUpdate();
+}
+
+Cloth& BatchSimulation::GetCloth()
+{
+    return *m_cloth;
+}
+
+Scene& BatchSimulation::GetScene()
+{
+    return *m_scene;
+}
@@ -0,0 +1,83 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - batchsimulation.h
+////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include "common.h"
+#include "callbacks.h"
+
+class ShaderManager;
+class CollisionSolver;
+class Scene;
+class Cloth;
+class Octree;
+class ThreadPool;
+
+/**
+* Simulation of a single cloth and scene without a window or rendering.
+* Uses a null reference device so meshes can still be created.
+*/
+class BatchSimulation
+{
+public:
+
+    /**
+    * Constructor
+    */
+    BatchSimulation();
+
+    /**
+    * Destructor
+    */
+    ~BatchSimulation();
+
+    /**
+    * Initialises the simulation
+    * @param threads The threads to solve the cloth with or zero for all cores
+    * @param deterministic Whether results must not depend on the thread count
+    * @param errorBuffer Filled with why the device or shaders could not be created
+    * @return whether initialisation succeeded
+    */
+    bool CreateSimulation(int threads, bool deterministic, std::string& errorBuffer);
+
+    /**
+    * Moves the simulation forward a single physics step
+    * @param deltatime The time of the physics step in seconds
+    */
+    void Update(float deltatime);
+
+    /**
+    * @return the simulated cloth
+    */
+    Cloth& GetCloth();
+
+    /**
+    * @return the scene the cloth collides with
+    */
+    Scene& GetScene();
+
+private:
+
+    /**
+    * Creates the null reference device
+    * @param errorBuffer Filled with why the device could not be created
+    * @return whether creation succeeded
+    */
+    bool CreateDevice(std::string& errorBuffer);
+
+    /**
+    * Prevent copying
+    */
+    BatchSimulation(const BatchSimulation&);
+    BatchSimulation& operator=(const BatchSimulation&);
+
+    std::unique_ptr<ShaderManager> m_shader;     ///< Manager for the simulation shaders
+    std::shared_ptr<CollisionSolver> m_solver;   ///< Collision solver for cloth
+    std::shared_ptr<Cloth> m_cloth;              ///< Simulation cloth object
+    std::unique_ptr<Scene> m_scene;              ///< Mesh manager for the scene
+    std::unique_ptr<Diagnostic> m_diagnostics;   ///< Diagnostic renderer
+    std::unique_ptr<Octree> m_octree;            ///< Octree spatial partitining
+    std::unique_ptr<ThreadPool> m_threadpool;    ///< Worker threads for the simulation
+    LPDIRECT3D9 m_d3d;                           ///< DirectX interface
+    LPDIRECT3DDEVICE9 m_d3ddev;                  ///< DirectX null reference device
+};
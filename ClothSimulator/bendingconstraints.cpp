@@ -0,0 +1,470 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - bendingconstraints.cpp
+////////////////////////////////////////////////////////////////////////////////////////
+
+#include "bendingconstraints.h"
+#include "particle.h"
+#include "spring.h"
+#include "threadpool.h"
+#include <algorithm>
+#include <assert.h>
+
+namespace
+{
+    const int COLOUR_BITS = 64;      ///< Constraint colours held in each word of a particle mask
+    const int BEND_GRAIN = 256;      ///< Minimum constraints given to a single thread
+
+    /**
+    * Finds the normals of the two triangles of a bend
+    * @param opposite1/opposite2 The particles not on the shared edge
+    * @param edge1/edge2 The particles of the shared edge
+    * @param normal1/normal2 Filled with the normals scaled by one over their length squared
+    * @return whether both triangles have an area
+    */
+    bool GetScaledNormals(const D3DXVECTOR3& opposite1, 
+                          const D3DXVECTOR3& opposite2,
+                          const D3DXVECTOR3& edge1, 
+                          const D3DXVECTOR3& edge2,
+                          D3DXVECTOR3& normal1,
+                          D3DXVECTOR3& normal2)
+    {
+        // Both triangles are wound around the edge in opposite 
+        // directions so the normals agree when the bend is flat
+        const D3DXVECTOR3 a(edge1 - opposite1);
+        const D3DXVECTOR3 b(edge2 - opposite1);
+        const D3DXVECTOR3 c(edge2 - opposite2);
+        const D3DXVECTOR3 d(edge1 - opposite2);
+        D3DXVec3Cross(&normal1, &a, &b);
+        D3DXVec3Cross(&normal2, &c, &d);
+
+        const float lengthSqr1 = D3DXVec3LengthSq(&normal1);
+        const float lengthSqr2 = D3DXVec3LengthSq(&normal2);
+        if(lengthSqr1 == 0.0f || lengthSqr2 == 0.0f)
+        {
+            return false;
+        }
+
+        normal1 /= lengthSqr1;
+        normal2 /= lengthSqr2;
+        return true;
+    }
+
+    /**
+    * @param normal1/normal2 The normals of the triangles of the bend
+    * @return the angle between the normals
+    */
+    float GetAngle(const D3DXVECTOR3& normal1, const D3DXVECTOR3& normal2)
+    {
+        const float cosAngle = D3DXVec3Dot(&normal1, &normal2) / 
+            std::sqrt(D3DXVec3LengthSq(&normal1) * D3DXVec3LengthSq(&normal2));
+        return std::acos(max(-1.0f, min(1.0f, cosAngle)));
+    }
+}
+
+BendingConstraints::BendingConstraints() :
+    m_stiffness(1.0f),
+    m_compliance(0.0f)
+{
+}
+
+void BendingConstraints::Initialise(const ParticleData& particles, 
+                                    const std::vector<int>& triangles)
+{
+    // Sort each edge by its particles so edges shared by two triangles sit together
+    struct Edge
+    {
+        int p1;        ///< Particle with the lower index
+        int p2;        ///< Particle with the higher index
+        int opposite;  ///< Particle of the triangle not on the edge
+    };
+
+    std::vector<Edge> edges;
+    edges.reserve(triangles.size());
+    for(unsigned int i = 0; i < triangles.size(); i += POINTS_IN_FACE)
+    {
+        for(int j = 0; j < POINTS_IN_FACE; ++j)
+        {
+            const int p1 = triangles[i+j];
+            const int p2 = triangles[i+((j+1)%POINTS_IN_FACE)];
+            Edge edge = { min(p1, p2), max(p1, p2), triangles[i+((j+2)%POINTS_IN_FACE)] };
+            edges.push_back(edge);
+        }
+    }
+
+    std::sort(edges.begin(), edges.end(), [](const Edge& a, const Edge& b)
+    {
+        return a.p1 != b.p1 ? a.p1 < b.p1 : a.p2 < b.p2;
+    });
+
+    // The rest shape is taken from where the particles started so
+    // constraints rebuilt after the cloth has moved keep their rest angle
+    const auto& positions = particles.initialPositions;
+    std::vector<Bend> bends;
+    for(unsigned int i = 1; i < edges.size(); ++i)
+    {
+        const Edge& previous = edges[i-1];
+        const Edge& edge = edges[i];
+        if(previous.p1 != edge.p1 || previous.p2 != edge.p2 || 
+           previous.opposite == edge.opposite)
+        {
+            continue;
+        }
+
+        Bend bend;
+        bend.opposite1 = previous.opposite;
+        bend.opposite2 = edge.opposite;
+        bend.edge1 = edge.p1;
+        bend.edge2 = edge.p2;
+
+        D3DXVECTOR3 normal1, normal2;
+        if(!GetScaledNormals(positions[bend.opposite1], positions[bend.opposite2],
+            positions[bend.edge1], positions[bend.edge2], normal1, normal2))
+        {
+            continue;
+        }
+
+        const D3DXVECTOR3 difference(positions[bend.opposite2] - positions[bend.opposite1]);
+        bend.restAngle = GetAngle(normal1, normal2);
+        bend.restDistance = D3DXVec3Length(&difference);
+        bends.push_back(bend);
+    }
+
+    // A constraint can only be kept from a colour by the other constraints of its
+    // four particles so masks four times as wide as the most constraints on a
+    // particle always leave a free colour, however many triangles share a vertex
+    std::vector<int> bendCounts(particles.positions.size(), 0);
+    for(const Bend& bend : bends)
+    {
+        ++bendCounts[bend.opposite1];
+        ++bendCounts[bend.opposite2];
+        ++bendCounts[bend.edge1];
+        ++bendCounts[bend.edge2];
+    }
+    const int maxBends = bendCounts.empty() ? 0 :
+        *std::max_element(bendCounts.begin(), bendCounts.end());
+    const int words = ((4 * maxBends) / COLOUR_BITS) + 1;
+
+    // Greedily give each constraint the lowest colour not used by any of its 
+    // particles; constraints of one colour can then be solved in any order
+    std::vector<unsigned long long> particleColours(particles.positions.size() * words, 0);
+    std::vector<int> bendColours(bends.size());
+    int colourCount = 0;
+
+    for(unsigned int i = 0; i < bends.size(); ++i)
+    {
+        const Bend& bend = bends[i];
+        unsigned long long* masks[] = 
+        {
+            &particleColours[bend.opposite1 * words],
+            &particleColours[bend.opposite2 * words],
+            &particleColours[bend.edge1 * words],
+            &particleColours[bend.edge2 * words]
+        };
+
+        int word = 0;
+        while((masks[0][word] | masks[1][word] | masks[2][word] | masks[3][word]) == ~0ull)
+        {
+            ++word;
+        }
+        assert(word < words);
+
+        const unsigned long long used = 
+            masks[0][word] | masks[1][word] | masks[2][word] | masks[3][word];
+
+        int bit = 0;
+        while(used & (1ull << bit))
+        {
+            ++bit;
+        }
+
+        for(unsigned long long* mask : masks)
+        {
+            mask[word] |= 1ull << bit;
+        }
+
+        const int colour = (word * COLOUR_BITS) + bit;
+        bendColours[i] = colour;
+        colourCount = max(colourCount, colour + 1);
+    }
+
+    // Group the constraints by colour keeping the edge order within each
+    m_colourStart.assign(colourCount + 1, 0);
+    for(int colour : bendColours)
+    {
+        ++m_colourStart[colour + 1];
+    }
+    for(int i = 1; i <= colourCount; ++i)
+    {
+        m_colourStart[i] += m_colourStart[i-1];
+    }
+
+    m_bends.resize(bends.size());
+    std::vector<int> offsets(m_colourStart.begin(), m_colourStart.end()-1);
+    for(unsigned int i = 0; i < bends.size(); ++i)
+    {
+        m_bends[offsets[bendColours[i]]++] = bends[i];
+    }
+
+    m_particleBends.assign(particles.positions.size(), std::vector<int>());
+    for(unsigned int i = 0; i < m_bends.size(); ++i)
+    {
+        const Bend& bend = m_bends[i];
+        for(unsigned int particle : { bend.opposite1, bend.opposite2, bend.edge1, bend.edge2 })
+        {
+            m_particleBends[particle].push_back(i);
+        }
+    }
+}
+
+void BendingConstraints::SplitParticle(int index, 
+                                       int split, 
+                                       const std::vector<int>& moved, 
+                                       const std::vector<int>& triangles)
+{
+    // Whether the triangle of the given particles now uses the new particle
+    auto isMoved = [&](unsigned int p1, unsigned int p2, unsigned int p3) -> bool
+    {
+        for(int triangle : moved)
+        {
+            int matches = 0;
+            for(int i = triangle*POINTS_IN_FACE; i < (triangle+1)*POINTS_IN_FACE; ++i)
+            {
+                const unsigned int particle = triangles[i] == split ? index : triangles[i];
+                matches += particle == p1 || particle == p2 || particle == p3 ? 1 : 0;
+            }
+            if(matches == POINTS_IN_FACE)
+            {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    // Removing or moving a constraint off the particle takes it out of the list
+    const unsigned int particle = static_cast<unsigned int>(index);
+    std::vector<int>& bends = m_particleBends[index];
+    for(unsigned int i = 0; i < bends.size();)
+    {
+        const Bend& bend = m_bends[bends[i]];
+        const bool moved1 = isMoved(bend.opposite1, bend.edge1, bend.edge2);
+        const bool moved2 = isMoved(bend.opposite2, bend.edge1, bend.edge2);
+
+        if(bend.edge1 == particle || bend.edge2 == particle)
+        {
+            // Triangles either side of a tear no longer share an edge
+            if(moved1 != moved2)
+            {
+                RemoveBend(bends[i]);
+            }
+            else if(moved1)
+            {
+                ReplaceParticle(bends[i], index, split);
+            }
+            else
+            {
+                ++i;
+            }
+        }
+        else if(bend.opposite1 == particle ? moved1 : moved2)
+        {
+            ReplaceParticle(bends[i], index, split);
+        }
+        else
+        {
+            ++i;
+        }
+    }
+}
+
+void BendingConstraints::AddParticle()
+{
+    m_particleBends.emplace_back();
+}
+
+void BendingConstraints::RemoveBend(int index)
+{
+    const Bend& bend = m_bends[index];
+    for(unsigned int particle : { bend.opposite1, bend.opposite2, bend.edge1, bend.edge2 })
+    {
+        auto& bends = m_particleBends[particle];
+        auto itr = std::find(bends.begin(), bends.end(), index);
+        *itr = bends.back();
+        bends.pop_back();
+    }
+
+    // Fill the gap with the last constraint of the colour, leaving a gap 
+    // at the start of the next colour to be filled with its last constraint
+    const int colourCount = static_cast<int>(m_colourStart.size()) - 1;
+    int colour = static_cast<int>(std::upper_bound(m_colourStart.begin(), 
+        m_colourStart.end(), index) - m_colourStart.begin()) - 1;
+
+    int gap = index;
+    for(; colour < colourCount; ++colour)
+    {
+        const int last = --m_colourStart[colour+1];
+        MoveBend(last, gap);
+        gap = last;
+    }
+    m_bends.pop_back();
+}
+
+void BendingConstraints::MoveBend(int from, int to)
+{
+    if(from != to)
+    {
+        m_bends[to] = m_bends[from];
+
+        const Bend& bend = m_bends[to];
+        for(unsigned int particle : { bend.opposite1, bend.opposite2, bend.edge1, bend.edge2 })
+        {
+            auto& bends = m_particleBends[particle];
+            *std::find(bends.begin(), bends.end(), from) = to;
+        }
+    }
+}
+
+void BendingConstraints::ReplaceParticle(int index, int from, int to)
+{
+    Bend& bend = m_bends[index];
+    for(unsigned int* particle : { &bend.opposite1, &bend.opposite2, &bend.edge1, &bend.edge2 })
+    {
+        if(*particle == static_cast<unsigned int>(from))
+        {
+            *particle = static_cast<unsigned int>(to);
+        }
+    }
+
+    auto& bends = m_particleBends[from];
+    bends.erase(std::find(bends.begin(), bends.end(), index));
+    m_particleBends[to].push_back(index);
+}
+
+void BendingConstraints::Solve(ParticleData& particles) const
+{
+    Solve(particles, 0, GetCount(), m_stiffness, 0.0f);
+}
+
+void BendingConstraints::Solve(ParticleData& particles, ThreadPool& pool) const
+{
+    for(unsigned int colour = 0; colour+1 < m_colourStart.size(); ++colour)
+    {
+        const int start = m_colourStart[colour];
+        pool.ParallelFor(m_colourStart[colour+1] - start, BEND_GRAIN,
+            [this, &particles, start](int begin, int end)
+            {
+                Solve(particles, start + begin, start + end, m_stiffness, 0.0f);
+            });
+    }
+}
+
+void BendingConstraints::SolveConstraints(ParticleData& particles, 
+                                          ThreadPool& pool, 
+                                          float substep) const
+{
+    // A single iteration is run each substep so the multipliers 
+    // start from zero and only the compliance needs to be scaled
+    const float compliance = m_compliance / (substep * substep);
+
+    for(unsigned int colour = 0; colour+1 < m_colourStart.size(); ++colour)
+    {
+        const int start = m_colourStart[colour];
+        pool.ParallelFor(m_colourStart[colour+1] - start, BEND_GRAIN,
+            [this, &particles, start, compliance](int begin, int end)
+            {
+                Solve(particles, start + begin, start + end, 1.0f, compliance);
+            });
+    }
+}
+
+void BendingConstraints::Solve(ParticleData& particles, 
+                               int begin, 
+                               int end,
+                               float stiffness, 
+                               float compliance) const
+{
+    D3DXVECTOR3* positions = &particles.positions[0];
+    const float* inverseMasses = &particles.inverseMasses[0];
+
+    for(int i = begin; i < end; ++i)
+    {
+        const Bend& bend = m_bends[i];
+        const float w0 = inverseMasses[bend.opposite1];
+        const float w1 = inverseMasses[bend.opposite2];
+        const float w2 = inverseMasses[bend.edge1];
+        const float w3 = inverseMasses[bend.edge2];
+
+        D3DXVECTOR3& p0 = positions[bend.opposite1];
+        D3DXVECTOR3& p1 = positions[bend.opposite2];
+        D3DXVECTOR3& p2 = positions[bend.edge1];
+        D3DXVECTOR3& p3 = positions[bend.edge2];
+
+        const D3DXVECTOR3 edge(p3 - p2);
+        const float edgeLength = D3DXVec3Length(&edge);
+        D3DXVECTOR3 normal1, normal2;
+        if(edgeLength == 0.0f || !GetScaledNormals(p0, p1, p2, p3, normal1, normal2))
+        {
+            continue;
+        }
+
+        // Gradient of the angle for each particle from Bender et al. 
+        // "Position-Based Simulation Methods in Computer Graphics"
+        const D3DXVECTOR3 offset0(p0 - p3);
+        const D3DXVECTOR3 offset1(p1 - p3);
+        const D3DXVECTOR3 offset2(p2 - p0);
+        const D3DXVECTOR3 offset3(p2 - p1);
+        const D3DXVECTOR3 gradient0(normal1 * edgeLength);
+        const D3DXVECTOR3 gradient1(normal2 * edgeLength);
+        const D3DXVECTOR3 gradient2((normal1 * D3DXVec3Dot(&offset0, &edge) +
+            normal2 * D3DXVec3Dot(&offset1, &edge)) / edgeLength);
+        const D3DXVECTOR3 gradient3((normal1 * D3DXVec3Dot(&offset2, &edge) +
+            normal2 * D3DXVec3Dot(&offset3, &edge)) / edgeLength);
+
+        const float weight = 
+            (w0 * D3DXVec3LengthSq(&gradient0)) + (w1 * D3DXVec3LengthSq(&gradient1)) +
+            (w2 * D3DXVec3LengthSq(&gradient2)) + (w3 * D3DXVec3LengthSq(&gradient3));
+
+        if(weight == 0.0f)
+        {
+            continue;
+        }
+
+        // The angle has no sign so flip the correction when folded the other way
+        D3DXVECTOR3 fold;
+        D3DXVec3Cross(&fold, &normal1, &normal2);
+        float lambda = stiffness * (GetAngle(normal1, normal2) - bend.restAngle) / 
+            (weight + compliance);
+
+        if(D3DXVec3Dot(&fold, &edge) > 0.0f)
+        {
+            lambda = -lambda;
+        }
+
+        p0 -= gradient0 * (w0 * lambda);
+        p1 -= gradient1 * (w1 * lambda);
+        p2 -= gradient2 * (w2 * lambda);
+        p3 -= gradient3 * (w3 * lambda);
+    }
+}
+
+void BendingConstraints::AddSprings(SpringBuffer& springs) const
+{
+    for(const Bend& bend : m_bends)
+    {
+        springs.AddSpring(bend.opposite1, bend.opposite2, bend.restDistance, Spring::BEND);
+    }
+}
+
+void BendingConstraints::SetStiffness(float stiffness)
+{
+    m_stiffness = stiffness;
+}
+
+void BendingConstraints::SetCompliance(float compliance)
+{
+    m_compliance = compliance;
+}
+
+int BendingConstraints::GetCount() const
+{
+    return static_cast<int>(m_bends.size());
+}
@@ -0,0 +1,152 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - bendingconstraints.h
+////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include "common.h"
+
+struct ParticleData;
+class SpringBuffer;
+class ThreadPool;
+
+/**
+* Dihedral angle between two triangles sharing an edge
+*/
+struct Bend
+{
+    unsigned int opposite1;  ///< Particle of the first triangle not on the edge
+    unsigned int opposite2;  ///< Particle of the second triangle not on the edge
+    unsigned int edge1;      ///< First particle of the shared edge
+    unsigned int edge2;      ///< Second particle of the shared edge
+    float restAngle;         ///< Angle between the triangle normals at rest
+    float restDistance;      ///< Distance between the opposite particles at rest
+};
+
+/**
+* Packed buffer of bending constraints for each pair of triangles sharing an edge.
+* Bending is measured by the angle between the triangles rather than the distance
+* between particles so folds are resisted equally in any direction across the cloth.
+*/
+class BendingConstraints
+{
+public:
+
+    /**
+    * Constructor
+    */
+    BendingConstraints();
+
+    /**
+    * Creates a constraint for each edge shared by two triangles then groups 
+    * them into colours where no two constraints share a particle
+    * @param particles The particle data holding the rest positions
+    * @param triangles The particle indices of each triangle
+    */
+    void Initialise(const ParticleData& particles, const std::vector<int>& triangles);
+
+    /**
+    * Moves the particles towards the rest angle of each constraint
+    * @param particles The particle data the constraints join
+    */
+    void Solve(ParticleData& particles) const;
+
+    /**
+    * Moves the particles towards the rest angle of each constraint
+    * with each colour of constraints split across the thread pool
+    * @param particles The particle data the constraints join
+    * @param pool The threads to solve with
+    */
+    void Solve(ParticleData& particles, ThreadPool& pool) const;
+
+    /**
+    * Solves the constraints as compliant constraints for a single substep
+    * with each colour of constraints split across the thread pool
+    * @param particles The particle data the constraints join
+    * @param pool The threads to solve with
+    * @param substep The fraction of the tick each substep covers
+    */
+    void SolveConstraints(ParticleData& particles, ThreadPool& pool, float substep) const;
+
+    /**
+    * Adds a spring between the opposite particles of each constraint for
+    * solvers that can only bend the cloth through distance constraints
+    * @param springs The springs to add to
+    */
+    void AddSprings(SpringBuffer& springs) const;
+
+    /**
+    * Updates the constraints around a particle split in two when tearing; those
+    * across the tear are removed and those of moved triangles follow the new particle
+    * @param index The particle that was split
+    * @param split The particle added for the moved triangles
+    * @param moved The triangles that now use the new particle
+    * @param triangles The particle indices of each triangle
+    */
+    void SplitParticle(int index, int split, 
+        const std::vector<int>& moved, const std::vector<int>& triangles);
+
+    /**
+    * Adds space for a new particle
+    */
+    void AddParticle();
+
+    /**
+    * Sets the fraction of the error corrected each time the constraints are solved
+    * @param stiffness The stiffness from zero to one
+    */
+    void SetStiffness(float stiffness);
+
+    /**
+    * Sets how much the constraints give under load when solved as compliant constraints
+    * @param compliance The inverse stiffness where zero is infinitely stiff
+    */
+    void SetCompliance(float compliance);
+
+    /**
+    * @return the number of constraints in the buffer
+    */
+    int GetCount() const;
+
+private:
+
+    /**
+    * Moves the particles towards the rest angle of each constraint
+    * @param particles The particle data the constraints join
+    * @param begin/end The range of constraints to solve
+    * @param stiffness The fraction of the error corrected
+    * @param compliance The compliance scaled by the substep squared
+    */
+    void Solve(ParticleData& particles, int begin, int end, 
+        float stiffness, float compliance) const;
+
+    /**
+    * Removes a constraint while keeping the colours packed
+    * @param index The index of the constraint to remove
+    */
+    void RemoveBend(int index);
+
+    /**
+    * Moves a constraint to another index of the buffer
+    * @param from/to The index to move the constraint from and to
+    */
+    void MoveBend(int from, int to);
+
+    /**
+    * Changes one of the particles of a constraint
+    * @param index The index of the constraint
+    * @param from/to The particle to replace and its replacement
+    */
+    void ReplaceParticle(int index, int from, int to);
+
+    /**
+    * Prevent copying
+    */
+    BendingConstraints(const BendingConstraints&);
+    BendingConstraints& operator=(const BendingConstraints&);
+
+    std::vector<Bend> m_bends;          ///< Constraints ordered by colour
+    std::vector<int> m_colourStart;     ///< Index of the first constraint of each colour
+    std::vector<std::vector<int>> m_particleBends; ///< Constraints using each particle
+    float m_stiffness;                  ///< Fraction of the error corrected when solved
+    float m_compliance;                 ///< Inverse stiffness when solved as compliant constraints
+};
@@ -7,6 +7,8 @@
 #include "GUIcallbacks.h"
 #include "octree_interface.h"
 
+class ThreadPool;
+
 /**
 * Functions required for mesh rendering/diagnostics
 */
@@ -36,5 +38,10 @@ struct Engine
     * Retrieves the octree interface
     */
     std::function<IOctree*(void)> octree;
+
+    /**
+    * Retrieves the worker threads for the simulation
+    */
+    std::function<ThreadPool*(void)> threadpool;
 };
 typedef std::shared_ptr<Engine> EnginePtr;
@@ -0,0 +1,77 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - chebyshevaccelerator.cpp
+////////////////////////////////////////////////////////////////////////////////////////
+
+#include "chebyshevaccelerator.h"
+#include "particle.h"
+#include "threadpool.h"
+
+namespace
+{
+    const float RADIUS_SCALE = 0.95f;  ///< Under estimate of the radius as the springs are not linear
+    const int DELAY = 2;               ///< Iterations relaxed before accelerating
+    const int PARTICLE_GRAIN = 1024;   ///< Minimum particles given to a single thread
+}
+
+ChebyshevAccelerator::ChebyshevAccelerator() :
+    m_spectralRadius(0.0f)
+{
+}
+
+float ChebyshevAccelerator::GetSpectralRadius() const
+{
+    return m_spectralRadius;
+}
+
+void ChebyshevAccelerator::SetSchedule(int iterations, int rows)
+{
+    // Gauss-Seidel on a chain of n particles converges at cos(pi/n)^2 
+    // and an error has to cross the length of the cloth to settle
+    const float radius = std::cos(static_cast<float>(D3DX_PI) / 
+        static_cast<float>(max(rows, 2)));
+    m_spectralRadius = radius * radius * RADIUS_SCALE;
+
+    // Extrapolating the first iterations overshoots as the relaxation
+    // has not settled into its slowest mode and feeds into the velocity
+    const float radiusSqr = m_spectralRadius * m_spectralRadius;
+    m_omegas.resize(max(iterations, 0));
+    for(unsigned int i = 0; i < m_omegas.size(); ++i)
+    {
+        if(i < DELAY)
+        {
+            m_omegas[i] = 1.0f;
+        }
+        else if(i == DELAY)
+        {
+            m_omegas[i] = 2.0f / (2.0f - radiusSqr);
+        }
+        else
+        {
+            m_omegas[i] = 4.0f / (4.0f - (radiusSqr * m_omegas[i-1]));
+        }
+    }
+}
+
+void ChebyshevAccelerator::Begin(const ParticleData& particles)
+{
+    m_previous = particles.positions;
+    m_current = particles.positions;
+}
+
+void ChebyshevAccelerator::Accelerate(ParticleData& particles, int iteration, ThreadPool& pool)
+{
+    const float omega = m_omegas[iteration];
+    pool.ParallelFor(static_cast<int>(particles.positions.size()), PARTICLE_GRAIN,
+        [this, &particles, omega](int begin, int end)
+        {
+            for(int i = begin; i < end; ++i)
+            {
+                // Particles without inverse mass are never moved by the springs
+                // so they stay on their previous position and need no check
+                D3DXVECTOR3& position = particles.positions[i];
+                position = ((position - m_previous[i]) * omega) + m_previous[i];
+                m_previous[i] = m_current[i];
+                m_current[i] = position;
+            }
+        });
+}
@@ -0,0 +1,64 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - chebyshevaccelerator.h
+////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include "common.h"
+
+struct ParticleData;
+class ThreadPool;
+
+/**
+* Chebyshev semi-iterative acceleration of the spring relaxation.
+* Each relaxed iterate is extrapolated from the iterate two before it as
+* q(k+1) = w(k+1) * (relaxed - q(k-1)) + q(k-1) where the weights only depend
+* on the spectral radius of the relaxation and so are found ahead of time.
+*/
+class ChebyshevAccelerator
+{
+public:
+
+    /**
+    * Constructor
+    */
+    ChebyshevAccelerator();
+
+    /**
+    * Estimates the spectral radius of the relaxation and the weight of each iteration
+    * @param iterations The number of relaxation iterations each tick
+    * @param rows The number of particles in a row/column of the cloth
+    */
+    void SetSchedule(int iterations, int rows);
+
+    /**
+    * Stores the positions before the first relaxation iteration
+    * @param particles The particle data being relaxed
+    */
+    void Begin(const ParticleData& particles);
+
+    /**
+    * Extrapolates the positions after a relaxation iteration
+    * @param particles The particle data holding the relaxed positions
+    * @param iteration The index of the iteration just relaxed
+    * @param pool The threads to solve with
+    */
+    void Accelerate(ParticleData& particles, int iteration, ThreadPool& pool);
+
+    /**
+    * @return the estimated spectral radius of the relaxation
+    */
+    float GetSpectralRadius() const;
+
+private:
+
+    /**
+    * Prevent copying
+    */
+    ChebyshevAccelerator(const ChebyshevAccelerator&);
+    ChebyshevAccelerator& operator=(const ChebyshevAccelerator&);
+
+    float m_spectralRadius;                ///< Estimated convergence rate of the relaxation
+    std::vector<float> m_omegas;           ///< Weight of the relaxed iterate for each iteration
+    std::vector<D3DXVECTOR3> m_previous;   ///< Positions two iterates before the relaxed positions
+    std::vector<D3DXVECTOR3> m_current;    ///< Positions before the latest relaxation
+};
@@ -7,9 +7,20 @@
 #include "particle.h"
 #include "collisionmesh.h"
 #include "spring.h"
+#include "implicitsolver.h"
+#include "projectivesolver.h"
+#include "hierarchicalsolver.h"
+#include "chebyshevaccelerator.h"
+#include "sleeptracker.h"
+#include "longrangeattachments.h"
+#include "bendingconstraints.h"
+#include "windfield.h"
 #include "shader.h"
+#include "assimpmesh.h"
 #include <functional>
 #include <algorithm>
+#include <map>
+#include <tuple>
 
 namespace 
 {
@@ -24,18 +35,84 @@ namespace
         MAX_COLORS
     };
 
-    const int ROWS = 20;                   ///< Initial rows for the cloth 
+    const int ROWS = 21;                   ///< Initial rows for the cloth 
     const int ITERATIONS = 2;              ///< Initial iterations for the cloth
     const float TIMESTEP = 0.45f;          ///< Initial timestep for the cloth
     const float DAMPING = 0.9f;            ///< Initial damping for the cloth
     const float SPACING = 0.75f;           ///< Initial particle spacing for the cloth
     const int PARTICLE_SUBDIVISIONS = 8;   ///< Subdivisions for cloth particles
     const float SMOOTH_INCREASE = 0.01f;   ///< Increase amount when changing smoothing
+    const float STRETCH_TOLERANCE = 0.02f; ///< Relative spring error accepted when adaptive
+    const int MAX_ADAPTIVE_ITERATIONS = 16;///< Most iterations relaxed each tick when adaptive
+
+    const float STRETCH_COMPLIANCE = 0.0f;    ///< Inverse stiffness of stretch constraints
+    const float SHEAR_COMPLIANCE = 0.0001f;   ///< Inverse stiffness of shear constraints
+    const float BEND_COMPLIANCE = 0.01f;      ///< Inverse stiffness of bend constraints
+    const float BEND_FRACTION = 0.25f;        ///< Fraction of the bend angle corrected each iteration
+    const float STRETCH_STIFFNESS = 20.0f;    ///< Stiffness of stretch springs when implicit
+    const float SHEAR_STIFFNESS = 10.0f;      ///< Stiffness of shear springs when implicit
+    const float BEND_STIFFNESS = 2.0f;        ///< Stiffness of bend springs when implicit
+    const float STRETCH_WEIGHT = 100.0f;      ///< Weight of stretch springs when projective
+    const float SHEAR_WEIGHT = 50.0f;         ///< Weight of shear springs when projective
+    const float BEND_WEIGHT = 10.0f;          ///< Weight of bend springs when projective
 
     const D3DXVECTOR3 STARTING_POSITION(0.5f, 8.0f, 0.0f); ///< Initial position for the cloth
+
+    const int MAX_TEARS = 16;  ///< Most overstretched springs torn each tick
+
+    const int MAX_SIMULATION_LEVEL = 2;  ///< Most times the simulated rows can be halved
+    const int MIN_LEVEL_ROWS = 4;        ///< Fewest rows a coarser simulated grid can have
+    const float LEVEL_DISTANCE = 50.0f;  ///< Camera distance covered by each simulation level
+    const float LEVEL_MARGIN = 0.1f;     ///< Fraction past its distances before a level changes
+
+    /**
+    * Length relative to the rest distance each type of spring tears at
+    */
+    const float TEAR_LIMITS[Spring::MAX_TYPES] = 
+    {
+        1.75f,  // Stretch
+        2.0f,   // Shear
+        2.25f   // Bend
+    };
+
+    const std::string SOLVER_NAMES[Cloth::MAX_SOLVERS] = 
+    {
+        "Serial", 
+        "Parallel",
+        "XPBD",
+        "Implicit",
+        "Projective",
+        "Multigrid",
+        "Chebyshev"
+    };
+
+    /**
+    * Finds the points of a square grid around a position within it
+    * @param rows The number of points in a row/column of the grid
+    * @param x/y The position measured in points along each side
+    * @param corners Filled with the index of the four surrounding points
+    * @param weights Filled with the bilinear weight of each point
+    */
+    void GetGridWeights(int rows, float x, float y, int corners[4], float weights[4])
+    {
+        const int lowerX = min(static_cast<int>(x), rows-2);
+        const int lowerY = min(static_cast<int>(y), rows-2);
+        const float weightX = x - lowerX;
+        const float weightY = y - lowerY;
+
+        corners[0] = (lowerX * rows) + lowerY;
+        corners[1] = (lowerX * rows) + lowerY + 1;
+        corners[2] = ((lowerX + 1) * rows) + lowerY;
+        corners[3] = ((lowerX + 1) * rows) + lowerY + 1;
+
+        weights[0] = (1.0f - weightX) * (1.0f - weightY);
+        weights[1] = (1.0f - weightX) * weightY;
+        weights[2] = weightX * (1.0f - weightY);
+        weights[3] = weightX * weightY;
+    }
 }
 
-Cloth::Cloth(EnginePtr engine) :
+Cloth::Cloth(EnginePtr engine, const D3DXVECTOR3& offset) :
     m_selectedRow(1),
     m_timestep(TIMESTEP),
     m_timestepSquared(TIMESTEP*TIMESTEP),
@@ -43,6 +120,9 @@ Cloth::Cloth(EnginePtr engine) :
     m_springCount(0),
     m_springIterations(ITERATIONS),
     m_particleLength(0),
+    m_detailLength(0),
+    m_simulationLevel(0),
+    m_fixedLevel(NO_INDEX),
     m_particleCount(0),
     m_quadVertices(0),
     m_simulation(false),
@@ -52,13 +132,24 @@ Cloth::Cloth(EnginePtr engine) :
     m_handleMode(false),
     m_subdivideCloth(false),
     m_gravity(0,-9.8f,0),
+    m_offset(offset),
     m_generalSmoothing(0.85f),
     m_engine(engine),
     m_template(nullptr),
     m_mesh(nullptr),
     m_texture(nullptr),
     m_shader(nullptr),
-    m_diagnosticParticle(0)
+    m_diagnosticParticle(0),
+    m_solver(PARALLEL_SOLVER),
+    m_adaptiveIterations(false),
+    m_iterationsUsed(0),
+    m_maxStretchError(0.0f),
+    m_rmsStretchError(0.0f),
+    m_tearing(false),
+    m_torn(false),
+    m_attach(false),
+    m_rebuildAttachments(true),
+    m_blowing(false)
 {
     D3DXVECTOR3 minimumScale(1.0f, 1.0f, 1.0f);
     D3DXVECTOR3 maximumScale(1.0f, 1.0f, 1.0f);
@@ -75,6 +166,29 @@ Cloth::Cloth(EnginePtr engine) :
         ShowMessageBox("Cannot create cloth texture");
     }
 
+    m_springs.SetCompliance(Spring::STRETCH, STRETCH_COMPLIANCE);
+    m_springs.SetCompliance(Spring::SHEAR, SHEAR_COMPLIANCE);
+
+    m_bending.reset(new BendingConstraints());
+    m_bending->SetStiffness(BEND_FRACTION);
+    m_bending->SetCompliance(BEND_COMPLIANCE);
+
+    m_implicit.reset(new ImplicitSolver());
+    m_implicit->SetStiffness(Spring::STRETCH, STRETCH_STIFFNESS);
+    m_implicit->SetStiffness(Spring::SHEAR, SHEAR_STIFFNESS);
+    m_implicit->SetStiffness(Spring::BEND, BEND_STIFFNESS);
+
+    m_projective.reset(new ProjectiveSolver());
+    m_projective->SetStiffness(Spring::STRETCH, STRETCH_WEIGHT);
+    m_projective->SetStiffness(Spring::SHEAR, SHEAR_WEIGHT);
+    m_projective->SetStiffness(Spring::BEND, BEND_WEIGHT);
+
+    m_hierarchy.reset(new HierarchicalSolver());
+    m_chebyshev.reset(new ChebyshevAccelerator());
+    m_sleep.reset(new SleepTracker());
+    m_attachments.reset(new LongRangeAttachments());
+    m_wind.reset(new WindField());
+
     m_colors.resize(MAX_COLORS);
     m_colors[NORMAL] = engine->diagnostic()->GetColor(Diagnostic::BLUE);
     m_colors[PINNED] = engine->diagnostic()->GetColor(Diagnostic::RED);
@@ -90,387 +204,1430 @@ Cloth::~Cloth()
 void Cloth::CreateCloth(int rows, float spacing)
 {
     m_spacing = spacing;
-    m_particleLength = rows;
-    m_particleCount = rows*rows;
+    m_detailLength = rows;
+    m_hiddenPins.clear();
+    m_heldPins.clear();
+
+    // Drop to the coarsest level the new rows can be simulated at
+    while(!CanSimulateLevel(m_simulationLevel))
+    {
+        --m_simulationLevel;
+    }
+    m_particleLength = GetLevelRows(m_simulationLevel);
+
+    // Lay the particles out in a grid spanning the rendered rows
+    const int mininum = -m_detailLength/2;
+    const float step = static_cast<float>(m_detailLength-1) / 
+        static_cast<float>(m_particleLength-1);
+
+    std::vector<D3DXVECTOR3> positions;
+    std::vector<D3DXVECTOR2> uvs;
+
+    for(int x = 0; x < m_particleLength; ++x)
+    {
+        for(int z = 0; z < m_particleLength; ++z)
+        {
+            D3DXVECTOR3 position = STARTING_POSITION + m_offset;
+            position.x += (mininum + (x*step))*m_spacing;
+            position.z += (mininum + (z*step))*m_spacing;
+            positions.push_back(position);
+            uvs.push_back(D3DXVECTOR2(z*step*0.5f, x*step*0.5f));
+        }
+    }
+
+    CreateParticles(positions, uvs);
+
+    // A coarser particle stands in for the mass of every rendered vertex it spans
+    for(int i = 0; i < m_particleCount; ++i)
+    {
+        m_particles.SetMass(i, m_particles.masses[i] * step * step);
+    }
+
+    // Set a centered particle as the one to draw any diagnostics
+    SelectParticleForDiagnostics(((m_particleLength/2) * m_particleLength) + (m_particleLength/2));
+
+    // Create the triangles of a grid with the given rows
+    auto createTriangles = [](int rows, std::vector<int>& triangles)
+    {
+        triangles.clear();
+        triangles.reserve(((rows-1)*(rows-1)) * 2 * POINTS_IN_FACE);
+        for(int x = 0; x < rows-1; ++x)
+        {
+            for(int y = 0; y < rows-1; ++y)
+            {
+                const int quad[] = 
+                {
+                    (x*rows)+y,
+                    (x*rows)+y+1,
+                    ((x+1)*rows)+y,
+                    ((x+1)*rows)+y,
+                    (x*rows)+y+1,
+                    ((x+1)*rows)+y+1
+                };
+                triangles.insert(triangles.end(), std::begin(quad), std::end(quad));
+            }
+        }
+    };
+
+    createTriangles(m_particleLength, m_triangles);
+
+    // Create the vertices; a coarser grid renders the vertices interpolated 
+    // from it so the rendered mesh is the same at every simulation level
+    const int detailCount = m_detailLength*m_detailLength;
+    m_quadVertices = m_subdivideCloth ? ((m_detailLength-1)*(m_detailLength-1)) : 0;
+    m_vertexData.resize(m_particleCount + (IsCoarse() ? 0 : m_quadVertices));
+    m_detailData.resize(IsCoarse() ? detailCount + m_quadVertices : 0);
+
+    // Create the indices
+    if(m_subdivideCloth)
+    {
+        m_indexData.resize(m_quadVertices * 4 * POINTS_IN_FACE);
+
+        int index = 0;
+        int quad = 0;
+
+        for(int x = 0; x < m_detailLength-1; ++x)
+        {
+            for(int y = 0; y < m_detailLength-1; ++y)
+            {
+                m_indexData[index]   = (x*m_detailLength)+y;
+                m_indexData[index+1] = (x*m_detailLength)+y+1;
+                m_indexData[index+2] = detailCount + quad;
+
+                m_indexData[index+3] = detailCount + quad;
+                m_indexData[index+4] = (x*m_detailLength)+y+1;
+                m_indexData[index+5] = ((x+1)*m_detailLength)+y+1;
+            
+                m_indexData[index+6] = ((x+1)*m_detailLength)+y;
+                m_indexData[index+7] = ((x+1)*m_detailLength)+y+1;
+                m_indexData[index+8] = detailCount + quad;
+            
+                m_indexData[index+9] = (x*m_detailLength)+y;
+                m_indexData[index+10] = detailCount + quad;
+                m_indexData[index+11] = ((x+1)*m_detailLength)+y;
+
+                ++quad;
+                index += 12;
+            }
+        }
+    }
+    else if(IsCoarse())
+    {
+        std::vector<int> triangles;
+        createTriangles(m_detailLength, triangles);
+        m_indexData.assign(triangles.begin(), triangles.end());
+    }
+    else
+    {
+        m_indexData.assign(m_triangles.begin(), m_triangles.end());
+    }
+
+    /* Connect neighbouring particles with springs along the triangle edges
+    ------ x
+    | /| /|    Stretch/Compression: Horizontal/Vertical springs
+    -------    Shear: Cross springs along the diagonal of each quad
+    | /| /|    Bending: Angle between triangles sharing an edge
+    ------              
+    y */
+
+    auto createSpring = [this](int x1, int y1, int x2, int y2, Spring::Type type)
+    {
+        m_springs.AddSpring(m_particles, GetParticle(x1, y1).GetIndex(),
+            GetParticle(x2, y2).GetIndex(), type);
+    };
+
+    m_springCount = (2*m_particleLength*(m_particleLength-1))
+        + ((m_particleLength-1)*(m_particleLength-1));
+
+    m_springs.Clear(m_springCount);
+    for(int x = 0; x < m_particleLength; ++x)
+    {
+        for(int y = 0; y < m_particleLength; ++y)
+        {
+            //Last y and first x don't have cross springs
+            if(y < m_particleLength-1 && x > 0)
+            {
+                createSpring(x, y, x-1, y+1, Spring::SHEAR);
+            }
+
+            //Last x doesn't have horizontal springs
+            if(x < m_particleLength-1)
+            {
+                createSpring(x, y, x+1, y, Spring::STRETCH);
+            }
+            
+            //Last y doesn't have vertical springs
+            if(y < m_particleLength-1)
+            {
+                createSpring(x, y, x, y+1, Spring::STRETCH);
+            }
+        }
+    }
+
+    InitialiseSolvers();
+    CreateMesh();
+}
+
+bool Cloth::LoadMesh(const std::string& path, std::string& errorBuffer)
+{
+    Assimpmesh mesh;
+    if(!mesh.Initialise(path, errorBuffer))
+    {
+        return false;
+    }
+
+    // Weld vertices sharing a position as the importer keeps them
+    // separate along uv seams where the cloth would otherwise tear
+    std::map<std::tuple<float, float, float>, int> welded;
+    std::vector<D3DXVECTOR3> positions;
+    std::vector<D3DXVECTOR2> uvs;
+    std::vector<int> triangles;
+
+    for(const Assimpmesh::SubMesh& subMesh : mesh.GetMeshes())
+    {
+        std::vector<int> vertexIndex(subMesh.vertices.size());
+        for(unsigned int i = 0; i < subMesh.vertices.size(); ++i)
+        {
+            const Assimpmesh::Vertex& vertex = subMesh.vertices[i];
+            auto key = std::make_tuple(vertex.x, vertex.y, vertex.z);
+            auto itr = welded.find(key);
+            if(itr == welded.end())
+            {
+                itr = welded.insert(std::make_pair(key, 
+                    static_cast<int>(positions.size()))).first;
+                positions.push_back(D3DXVECTOR3(vertex.x, vertex.y, vertex.z));
+                uvs.push_back(D3DXVECTOR2(vertex.u, vertex.v));
+            }
+            vertexIndex[i] = itr->second;
+        }
+
+        for(unsigned int i = 0; i+2 < subMesh.indices.size(); i += POINTS_IN_FACE)
+        {
+            const int p1 = vertexIndex[subMesh.indices[i]];
+            const int p2 = vertexIndex[subMesh.indices[i+1]];
+            const int p3 = vertexIndex[subMesh.indices[i+2]];
+
+            // Welding can collapse thin triangles down to an edge
+            if(p1 != p2 && p2 != p3 && p1 != p3)
+            {
+                triangles.push_back(p1);
+                triangles.push_back(p2);
+                triangles.push_back(p3);
+            }
+        }
+    }
+
+    if(triangles.empty())
+    {
+        errorBuffer = "Cloth mesh " + path + " has no triangles";
+        return false;
+    }
+
+    // Order the particles so those sharing a triangle sit close together
+    const int vertexCount = static_cast<int>(positions.size());
+    std::vector<std::vector<int>> neighbours(vertexCount);
+    for(unsigned int i = 0; i < triangles.size(); i += POINTS_IN_FACE)
+    {
+        for(int j = 0; j < POINTS_IN_FACE; ++j)
+        {
+            const int p1 = triangles[i+j];
+            const int p2 = triangles[i+((j+1)%POINTS_IN_FACE)];
+            neighbours[p1].push_back(p2);
+            neighbours[p2].push_back(p1);
+        }
+    }
+
+    for(auto& vertexNeighbours : neighbours)
+    {
+        std::sort(vertexNeighbours.begin(), vertexNeighbours.end());
+        vertexNeighbours.erase(std::unique(vertexNeighbours.begin(),
+            vertexNeighbours.end()), vertexNeighbours.end());
+    }
+
+    const std::vector<int> order = OrderParticles(neighbours);
+    std::vector<int> newIndex(vertexCount, NO_INDEX);
+    for(unsigned int i = 0; i < order.size(); ++i)
+    {
+        newIndex[order[i]] = static_cast<int>(i);
+    }
+
+    // Store the mesh centered with an average edge length of one
+    // so the spacing of the cloth sets the size of the mesh
+    D3DXVECTOR3 minBounds(positions[0]), maxBounds(positions[0]);
+    for(const D3DXVECTOR3& position : positions)
+    {
+        D3DXVec3Minimize(&minBounds, &minBounds, &position);
+        D3DXVec3Maximize(&maxBounds, &maxBounds, &position);
+    }
+    const D3DXVECTOR3 center((minBounds + maxBounds) * 0.5f);
+
+    float edgeLength = 0.0f;
+    int edgeCount = 0;
+    for(int i = 0; i < vertexCount; ++i)
+    {
+        for(int neighbour : neighbours[i])
+        {
+            const D3DXVECTOR3 edge(positions[neighbour] - positions[i]);
+            edgeLength += D3DXVec3Length(&edge);
+            ++edgeCount;
+        }
+    }
+    const float scale = edgeLength > 0.0f ? edgeCount / edgeLength : 1.0f;
+
+    m_meshPositions.resize(order.size());
+    m_meshUvs.resize(order.size());
+    for(unsigned int i = 0; i < order.size(); ++i)
+    {
+        m_meshPositions[i] = (positions[order[i]] - center) * scale;
+        m_meshUvs[i] = uvs[order[i]];
+    }
+
+    m_meshTriangles.resize(triangles.size());
+    for(unsigned int i = 0; i < triangles.size(); ++i)
+    {
+        m_meshTriangles[i] = newIndex[triangles[i]];
+    }
+
+    CreateMeshCloth(m_spacing);
+    return true;
+}
+
+std::vector<int> Cloth::OrderParticles(const std::vector<std::vector<int>>& neighbours)
+{
+    // Cuthill-McKee ordering: a breadth first search starting from the least
+    // connected particle, visiting neighbours with the fewest connections first
+    const int count = static_cast<int>(neighbours.size());
+    std::vector<int> order;
+    std::vector<unsigned char> visited(count, 0);
+    order.reserve(count);
+
+    auto byDegree = [&neighbours](int a, int b)
+    {
+        return neighbours[a].size() < neighbours[b].size();
+    };
+
+    while(static_cast<int>(order.size()) < count)
+    {
+        int start = NO_INDEX;
+        for(int i = 0; i < count; ++i)
+        {
+            if(!visited[i] && (start == NO_INDEX || byDegree(i, start)))
+            {
+                start = i;
+            }
+        }
+
+        visited[start] = 1;
+        order.push_back(start);
+
+        for(unsigned int next = order.size()-1; next < order.size(); ++next)
+        {
+            std::vector<int> unvisited;
+            for(int neighbour : neighbours[order[next]])
+            {
+                if(!visited[neighbour])
+                {
+                    visited[neighbour] = 1;
+                    unvisited.push_back(neighbour);
+                }
+            }
+            std::stable_sort(unvisited.begin(), unvisited.end(), byDegree);
+            order.insert(order.end(), unvisited.begin(), unvisited.end());
+        }
+    }
+    return order;
+}
+
+void Cloth::CreateMeshCloth(float spacing)
+{
+    // Only the grid can be simulated coarser than it is rendered
+    m_spacing = spacing;
+    m_simulationLevel = 0;
+    m_detailData.clear();
+
+    std::vector<D3DXVECTOR3> positions(m_meshPositions.size());
+    for(unsigned int i = 0; i < positions.size(); ++i)
+    {
+        positions[i] = STARTING_POSITION + m_offset + (m_meshPositions[i] * m_spacing);
+    }
+
+    CreateParticles(positions, m_meshUvs);
+
+    // Set the particle closest to the center as the one to draw any diagnostics
+    int diagnosticParticle = 0;
+    for(int i = 1; i < m_particleCount; ++i)
+    {
+        if(D3DXVec3LengthSq(&m_meshPositions[i]) < 
+            D3DXVec3LengthSq(&m_meshPositions[diagnosticParticle]))
+        {
+            diagnosticParticle = i;
+        }
+    }
+    SelectParticleForDiagnostics(diagnosticParticle);
+
+    m_triangles = m_meshTriangles;
+    m_quadVertices = 0;
+    m_vertexData.resize(m_particleCount);
+    m_indexData.assign(m_triangles.begin(), m_triangles.end());
+
+    // Sort each edge by its particles so edges shared by two triangles sit together
+    struct Edge
+    {
+        int p1;        ///< Particle with the lower index
+        int p2;        ///< Particle with the higher index
+        int opposite;  ///< Particle of the triangle not on the edge
+    };
+
+    std::vector<Edge> edges;
+    edges.reserve(m_triangles.size());
+    for(unsigned int i = 0; i < m_triangles.size(); i += POINTS_IN_FACE)
+    {
+        for(int j = 0; j < POINTS_IN_FACE; ++j)
+        {
+            const int p1 = m_triangles[i+j];
+            const int p2 = m_triangles[i+((j+1)%POINTS_IN_FACE)];
+            Edge edge = { min(p1, p2), max(p1, p2), m_triangles[i+((j+2)%POINTS_IN_FACE)] };
+            edges.push_back(edge);
+        }
+    }
+
+    std::sort(edges.begin(), edges.end(), [](const Edge& a, const Edge& b)
+    {
+        return a.p1 != b.p1 ? a.p1 < b.p1 : a.p2 < b.p2;
+    });
+
+    /* Connect the particles with springs
+    Stretch/Compression: Each unique edge of the triangles
+    Bending: Angle between triangles sharing an edge */
+
+    m_springCount = static_cast<int>(edges.size());
+    m_springs.Clear(m_springCount);
+    for(unsigned int i = 0; i < edges.size(); ++i)
+    {
+        const Edge& edge = edges[i];
+        if(i == 0 || edges[i-1].p1 != edge.p1 || edges[i-1].p2 != edge.p2)
+        {
+            m_springs.AddSpring(m_particles, edge.p1, edge.p2, Spring::STRETCH);
+        }
+    }
+    m_springCount = m_springs.GetCount();
+
+    InitialiseSolvers();
+    CreateMesh();
+}
+
+void Cloth::CreateParticles(const std::vector<D3DXVECTOR3>& positions,
+                            const std::vector<D3DXVECTOR2>& uvs)
+{
+    m_particleCount = static_cast<int>(positions.size());
 
     // Remove any particles from octree no longer needed
-    int current = static_cast<int>(m_particles.size());
+    int current = static_cast<int>(m_particles.positions.size());
     int difference = current - m_particleCount;
     if(difference > 0)
     {
         for(int i = current-difference; i < current; ++i)
         {
-            m_engine->octree()->RemoveObject(m_particles[i]->GetCollisionMesh());
+            m_engine->octree()->RemoveObject(*m_particles.collisions[i]);
         }
     }
 
+    // Particles of a coarser grid are further apart so are larger to cover the gaps
+    const float spacing = IsCoarse() ? m_spacing * static_cast<float>(m_detailLength-1) / 
+        static_cast<float>(m_particleLength-1) : m_spacing;
+
     // Create the particles
-    m_particles.resize(m_particleCount);
-    m_template->SetLocalScale(m_spacing/2.0f);
-    const int mininum = -m_particleLength/2;
-    const int maximum = m_particleLength/2;
+    m_particles.Resize(m_particleCount);
+    m_template->SetLocalScale(spacing/2.0f);
 
     // Modify visual radius depending on the spacing
     // Line chosen passes through (0.75, 0.15), (1.0, 0.18)
     const float lineslope = 0.12f;
     const float lineoffset = 0.06f;
-    const float visualRadius = (lineslope * m_spacing) + lineoffset;
+    m_particles.visualRadius = (lineslope * spacing) + lineoffset;
 
-    float UVu = 0;
-    float UVv = 0;
-    int index = 0;
+    for(int index = 0; index < m_particleCount; ++index)
+    {
+        bool firstInitialisation = !m_particles.collisions[index];
+
+        Particle particle(m_particles, index);
+        particle.Initialise(m_engine, positions[index], uvs[index], *m_template);
+
+        if(firstInitialisation)
+        {
+            m_engine->octree()->AddObject(particle.GetCollisionMesh());
+        }
+    }
+
+    m_previousState = m_particles.positions;
+}
+
+void Cloth::InitialiseSolvers()
+{
+    m_torn = false;
+    m_rebuildAttachments = true;
+    m_springs.SortSprings(m_particleCount);
+    m_bending->Initialise(m_particles, m_triangles);
+    InitialiseLinearSolvers();
+    m_chebyshev->SetSchedule(GetIterationLimit(), GetSolverRows());
+
+    if(IsMeshCloth())
+    {
+        // Coarser levels are built from the grid rows so
+        // the multigrid solver only relaxes the mesh itself
+        m_hierarchy->Initialise(m_particles, 0);
+        m_sleep->Initialise(m_particles, m_springs);
+    }
+    else
+    {
+        m_hierarchy->Initialise(m_particles, m_particleLength);
+        m_sleep->Initialise(m_particles, m_particleLength);
+    }
 
-    for(int x = mininum; x < maximum; ++x)
+    // Tearing splits particles by the triangles around them
+    m_particleTriangles.assign(m_particleCount, std::vector<int>());
+    for(unsigned int i = 0; i < m_triangles.size(); ++i)
     {
-        for(int z = mininum; z < maximum; ++z, ++index)
+        m_particleTriangles[m_triangles[i]].push_back(i / POINTS_IN_FACE);
+    }
+}
+
+void Cloth::InitialiseLinearSolvers()
+{
+    // These solvers only bend the cloth through springs so add 
+    // one between the opposite particles of each bending constraint
+    m_linearSprings = m_springs;
+    m_bending->AddSprings(m_linearSprings);
+    m_linearSprings.SortSprings(m_particleCount);
+
+    m_implicit->Initialise(m_linearSprings, m_particleCount);
+    m_projective->Initialise(m_linearSprings, m_particleCount);
+}
+
+void Cloth::CreateMesh()
+{
+    //Mesh Vertex Declaration
+    D3DVERTEXELEMENT9 VertexDec[] =
+    {
+        { 0, 0,  D3DDECLTYPE_FLOAT3, D3DDECLMETHOD_DEFAULT, D3DDECLUSAGE_POSITION, 0 },
+        { 0, 12, D3DDECLTYPE_FLOAT3, D3DDECLMETHOD_DEFAULT, D3DDECLUSAGE_NORMAL,   0 },     
+        { 0, 24, D3DDECLTYPE_FLOAT2, D3DDECLMETHOD_DEFAULT, D3DDECLUSAGE_TEXCOORD, 0 },
+        D3DDECL_END()
+    };
+
+    //Create the mesh
+    if(m_mesh)
+    {
+        m_mesh->Release();
+        m_mesh = nullptr;
+    }
+
+    const std::vector<MeshVertex>& vertices = GetRenderedVertices();
+    const int triangleNumber = static_cast<int>(m_indexData.size()) / POINTS_IN_FACE;
+    if(FAILED(D3DXCreateMesh(triangleNumber, vertices.size(),
+        D3DXMESH_VB_DYNAMIC | D3DXMESH_IB_MANAGED | D3DXMESH_32BIT,
+        VertexDec, m_engine->device(), &m_mesh)))
+    {
+        m_mesh = nullptr;
+        ShowMessageBox("Cloth Mesh creation failed");
+    }
+
+    UpdateVertices(1.0f);
+    UpdateDetailVertices();
+
+    #pragma warning(disable: 4996)
+
+    //Vertex Buffer
+    void* vertexBuffer = nullptr;
+    if(FAILED(m_mesh->LockVertexBuffer(0, &vertexBuffer)))
+    {
+        ShowMessageBox("Cloth Vertex buffer lock failed");
+    }
+    std::copy(vertices.begin(), vertices.end(), (MeshVertex*)vertexBuffer);
+    m_mesh->UnlockVertexBuffer();
+
+    //Index Buffer
+    void* indexdata = nullptr;
+    if(FAILED(m_mesh->LockIndexBuffer(0, &indexdata)))
+    {
+        ShowMessageBox("Cloth Index buffer lock failed");
+    }
+    std::copy(m_indexData.begin(), m_indexData.end(), (DWORD*)indexdata);
+    m_mesh->UnlockIndexBuffer();
+}
+
+bool Cloth::IsMeshCloth() const
+{
+    return !m_meshPositions.empty();
+}
+
+bool Cloth::IsAsleep() const
+{
+    return m_sleep->IsAsleep();
+}
+
+bool Cloth::IsCoarse() const
+{
+    return m_simulationLevel > 0;
+}
+
+int Cloth::GetLevelRows(int level) const
+{
+    return ((m_detailLength-1) >> level) + 1;
+}
+
+bool Cloth::CanSimulateLevel(int level) const
+{
+    // Every particle of a coarser grid must sit on a rendered vertex 
+    // so each level is a subset of all the finer levels below it
+    return level == 0 || (((m_detailLength-1) % (1 << level)) == 0 &&
+        GetLevelRows(level) >= MIN_LEVEL_ROWS);
+}
+
+std::vector<MeshVertex>& Cloth::GetRenderedVertices()
+{
+    return IsCoarse() ? m_detailData : m_vertexData;
+}
+
+int Cloth::GetSolverRows() const
+{
+    // A mesh is treated as a square grid of the same particle count
+    return IsMeshCloth() ? static_cast<int>(std::ceil(
+        std::sqrt(static_cast<float>(m_particleCount)))) : m_particleLength;
+}
+
+void Cloth::Draw(const D3DXVECTOR3& cameraPos, const Matrix& projection, const Matrix& view)
+{
+    m_shader->SetTechnique(DxConstant::DefaultTechnique);
+    m_shader->SetFloatArray(DxConstant::CameraPosition, &(cameraPos.x), 3);
+    m_shader->SetTexture(DxConstant::DiffuseTexture, m_texture);
+    m_engine->sendLightsToShader(m_shader);
+
+    D3DXMATRIX worldInvTrans;
+    D3DXMATRIX worldViewProj = GetMatrix() * view.GetMatrix() * projection.GetMatrix();
+    D3DXMatrixInverse(&worldInvTrans, 0, &GetMatrix());
+    D3DXMatrixTranspose(&worldInvTrans, &worldInvTrans);
+
+    m_shader->SetMatrix(DxConstant::WorldInverseTranspose, &worldInvTrans);
+    m_shader->SetMatrix(DxConstant::WordViewProjection, &worldViewProj);
+    m_shader->SetMatrix(DxConstant::World, &GetMatrix());
+
+    UINT nPasses = 0;
+    m_shader->Begin(&nPasses, 0);
+    for(UINT iPass = 0; iPass < nPasses; ++iPass)
+    {
+        m_shader->BeginPass(iPass);
+        m_mesh->DrawSubset(0);
+        m_shader->EndPass();
+    }
+    m_shader->End();
+}
+
+void Cloth::SetHandleMode(bool set)
+{
+    m_handleMode = set;
+    ChangeRow(m_selectedRow, m_handleMode);
+}
+
+void Cloth::SetVertexVisibility(bool draw)
+{
+    m_drawVisualParticles = draw;
+}
+
+void Cloth::SetCollisionVisibility(bool draw)
+{
+    m_drawColParticles = draw;
+}
+
+void Cloth::UnpinCloth()
+{
+    for(int i = 0; i < m_particleCount; ++i)
+    {
+        Particle particle(m_particles, i);
+        particle.PinParticle(false); 
+        SetParticleColor(particle);
+    }
+    m_hiddenPins.clear();
+    m_heldPins.clear();
+    m_sleep->WakeAll(m_particles);
+    m_rebuildAttachments = true;
+}
+
+void Cloth::SetSimulation(bool simulating)
+{
+    m_simulation = simulating;
+    m_sleep->WakeAll(m_particles);
+}
+
+void Cloth::AddForce(const D3DXVECTOR3& force)
+{
+    m_particles.AddForce(force);
+}
+
+void Cloth::PreCollisionUpdate(float deltatime)
+{
+    m_previousState = m_particles.positions;
+
+    // Move cloth down slowly
+    if(m_simulation)
+    {
+        m_particles.AddAcceleration(m_gravity*m_timestepSquared*deltatime);
+
+        if(m_blowing)
         {
-            bool firstInitialisation = !m_particles[index].get();
-            D3DXVECTOR2 uvs(UVu, UVv);
-            D3DXVECTOR3 position = STARTING_POSITION;
-            position.x += x*m_spacing;
-            position.z += z*m_spacing;
+            m_wind->Apply(m_particles, m_triangles, m_particleTriangles, 
+                *m_engine->threadpool(), deltatime, m_timestepSquared*deltatime);
+        }
+    }
 
-            if(firstInitialisation)
-            {
-                m_particles[index].reset(new Particle(m_engine));
-            }
+    // Tethers only follow the pins and springs so are kept until either changes
+    if(m_attach && m_rebuildAttachments)
+    {
+        m_attachments->Initialise(m_particles, m_springs);
+        m_rebuildAttachments = false;
+    }
+    
+    if(m_solver == XPBD_SOLVER)
+    {
+        SolveExtendedPositionBased();
+    }
+    else if(m_solver == IMPLICIT_SOLVER)
+    {
+        m_implicit->Solve(m_particles, m_linearSprings, 
+            *m_engine->threadpool(), m_damping, m_timestepSquared);
+    }
+    else if(m_solver == PROJECTIVE_SOLVER)
+    {
+        m_projective->Solve(m_particles, m_linearSprings, *m_engine->threadpool(), 
+            m_springIterations, m_damping, m_timestep);
+    }
+    else
+    {
+        SolvePositionBased();
+    }
 
-            m_particles[index]->Initialise(position, uvs, 
-                index, *m_template, visualRadius);
+    // Springs and integration only write the particle data;
+    // sync the collisions once now that they have finished
+    for(int i = 0; i < m_particleCount; ++i)
+    {
+        Particle(m_particles, i).UpdateCollisionPosition();
+    }
+}
 
-            if(firstInitialisation)
+bool Cloth::IsPositionBased() const
+{
+    return m_solver != XPBD_SOLVER && 
+        m_solver != IMPLICIT_SOLVER && 
+        m_solver != PROJECTIVE_SOLVER;
+}
+
+void Cloth::SolvePositionBased()
+{
+    // Nothing will move until a collision or the user wakes the cloth
+    if(m_sleep->IsAsleep())
+    {
+        return;
+    }
+
+    // Solve Springs
+    m_particles.UpdateInteractingVelocities();
+    if(m_solver == CHEBYSHEV_SOLVER)
+    {
+        m_chebyshev->Begin(m_particles);
+    }
+
+    const int iterations = GetIterationLimit();
+    for(m_iterationsUsed = 0; m_iterationsUsed < iterations; ++m_iterationsUsed)
+    {
+        if(m_solver == PARALLEL_SOLVER)
+        {
+            m_springs.SolveSprings(m_particles, *m_engine->threadpool());
+            m_bending->Solve(m_particles, *m_engine->threadpool());
+        }
+        else if(m_solver == CHEBYSHEV_SOLVER)
+        {
+            m_springs.SolveSprings(m_particles, *m_engine->threadpool());
+            m_bending->Solve(m_particles, *m_engine->threadpool());
+            m_chebyshev->Accelerate(m_particles, 
+                m_iterationsUsed, *m_engine->threadpool());
+        }
+        else if(m_solver == MULTIGRID_SOLVER)
+        {
+            m_hierarchy->Solve(m_particles, m_springs, *m_engine->threadpool());
+            m_bending->Solve(m_particles, *m_engine->threadpool());
+        }
+        else
+        {
+            m_springs.SolveSprings(m_particles);
+            m_bending->Solve(m_particles);
+        }
+
+        if(m_attach)
+        {
+            m_attachments->Solve(m_particles, *m_engine->threadpool());
+        }
+
+        if(m_adaptiveIterations)
+        {
+            m_maxStretchError = m_springs.MeasureError(
+                m_particles, *m_engine->threadpool(), m_rmsStretchError);
+
+            if(m_maxStretchError <= STRETCH_TOLERANCE)
             {
-                m_engine->octree()->AddObject(m_particles[index]->GetCollisionMesh());
+                ++m_iterationsUsed;
+                break;
             }
-
-            UVu += 0.5;
         }
-        UVu = 0;
-        UVv += 0.5;
     }
 
-    // Set a centered particle as the one to draw any diagnostics
-    m_diagnosticParticle = ((m_particleLength/2) * m_particleLength) + (m_particleLength/2);
-    auto& collision = m_particles[m_diagnosticParticle]->GetCollisionMesh();
-    collision.SetRenderSolverDiagnostics(true);
+    // Updating particle positions
+    m_particles.Integrate(m_damping, m_timestepSquared);
+}
 
-    // Create the vertices
-    m_quadVertices = m_subdivideCloth ? ((m_particleLength-1)*(m_particleLength-1)) : 0;
-    const int vertexCount = m_particleCount + m_quadVertices;
-    m_vertexData.resize(vertexCount);
+void Cloth::SolveExtendedPositionBased()
+{
+    // Iterations become substeps as stiffness no longer depends on them
+    const int substeps = max(m_springIterations, 1);
+    const float substep = 1.0f / static_cast<float>(substeps);
+    const float damping = std::pow(m_damping, substep);
 
-    // Create the indices
-    const int trianglesPerQuad = m_subdivideCloth ? 4 : 2;
-    int triangleNumber = ((m_particleLength-1)*(m_particleLength-1)) * trianglesPerQuad;
-    m_indexData.resize(triangleNumber * POINTS_IN_FACE);
+    m_particles.BeginSubsteps();
+    for(int j = 0; j < substeps; ++j)
+    {
+        m_particles.IntegrateSubstep(damping, m_timestepSquared, substep);
+        m_springs.SolveConstraints(m_particles, *m_engine->threadpool(), substep);
+        m_bending->SolveConstraints(m_particles, *m_engine->threadpool(), substep);
+        if(m_attach)
+        {
+            m_attachments->Solve(m_particles, *m_engine->threadpool());
+        }
+        m_particles.UpdateSubstepVelocities(substep);
+    }
+    m_particles.EndSubsteps();
+}
 
-    index = 0;
-    int quad = 0;
+void Cloth::UpdateDiagnostics()
+{
+    auto& renderer = *m_engine->diagnostic();
+    Particle(m_particles, m_diagnosticParticle).UpdateDiagnostics(renderer);
 
-    for(int x = 0; x < m_particleLength-1; ++x)
+    if(renderer.AllowDiagnostics(Diagnostic::CLOTH))
     {
-        for(int y = 0; y < m_particleLength-1; ++y)
+        m_springs.UpdateDiagnostics(renderer, m_particles);
+
+        renderer.UpdateText(Diagnostic::CLOTH, 
+            "ParticleCount", Diagnostic::WHITE, StringCast(m_particleCount));
+
+        renderer.UpdateText(Diagnostic::CLOTH, 
+            "Solver", Diagnostic::WHITE, SOLVER_NAMES[m_solver]);
+
+        renderer.UpdateText(Diagnostic::CLOTH, 
+            "SpringColours", Diagnostic::WHITE, StringCast(m_springs.GetColourCount()));
+
+        renderer.UpdateText(Diagnostic::CLOTH, 
+            "BendConstraints", Diagnostic::WHITE, StringCast(m_bending->GetCount()));
+
+        renderer.UpdateText(Diagnostic::CLOTH, 
+            "SpringKernel", Diagnostic::WHITE, m_springs.GetInstructionSetName());
+
+        renderer.UpdateText(Diagnostic::CLOTH, 
+            "StateHash", Diagnostic::WHITE, StringCast(m_particles.GetStateHash()));
+
+        if(m_adaptiveIterations && IsPositionBased())
         {
-            if(m_subdivideCloth)
-            {
-                m_indexData[index]   = (x*m_particleLength)+y;
-                m_indexData[index+1] = (x*m_particleLength)+y+1;
-                m_indexData[index+2] = m_particleCount + quad;
+            renderer.UpdateText(Diagnostic::CLOTH, "SpringIterations", 
+                Diagnostic::WHITE, StringCast(m_iterationsUsed));
 
-                m_indexData[index+3] = m_particleCount + quad;
-                m_indexData[index+4] = (x*m_particleLength)+y+1;
-                m_indexData[index+5] = ((x+1)*m_particleLength)+y+1;
-            
-                m_indexData[index+6] = ((x+1)*m_particleLength)+y;
-                m_indexData[index+7] = ((x+1)*m_particleLength)+y+1;
-                m_indexData[index+8] = m_particleCount + quad;
-            
-                m_indexData[index+9] = (x*m_particleLength)+y;
-                m_indexData[index+10] = m_particleCount + quad;
-                m_indexData[index+11] = ((x+1)*m_particleLength)+y;
-            }
-            else
-            {
-                m_indexData[index] = (x*m_particleLength)+y;
-                m_indexData[index+1] = (x*m_particleLength)+y+1;
-                m_indexData[index+2] = ((x+1)*m_particleLength)+y;
+            renderer.UpdateText(Diagnostic::CLOTH, "MaxStretchError", 
+                Diagnostic::WHITE, StringCast(m_maxStretchError));
 
-                m_indexData[index+3] = ((x+1)*m_particleLength)+y;
-                m_indexData[index+4] = (x*m_particleLength)+y+1;
-                m_indexData[index+5] = ((x+1)*m_particleLength)+y+1;
-            }
+            renderer.UpdateText(Diagnostic::CLOTH, "RmsStretchError", 
+                Diagnostic::WHITE, StringCast(m_rmsStretchError));
+        }
 
-            ++quad;
-            index += m_subdivideCloth ? 12 : 6;
+        if(m_blowing)
+        {
+            const D3DXVECTOR3 wind(m_wind->GetVelocity(m_particles.positions[m_diagnosticParticle]));
+            renderer.UpdateText(Diagnostic::CLOTH, "WindSpeed", 
+                Diagnostic::WHITE, StringCast(D3DXVec3Length(&wind)));
+        }
+
+        if(m_attach)
+        {
+            renderer.UpdateText(Diagnostic::CLOTH, "Attachments", 
+                Diagnostic::WHITE, StringCast(m_attachments->GetCount()));
+        }
+
+        renderer.UpdateText(Diagnostic::CLOTH, "SimulationLevel", Diagnostic::WHITE, 
+            StringCast(m_simulationLevel) + (m_fixedLevel == NO_INDEX ? " (Camera)" : ""));
+
+        renderer.UpdateText(Diagnostic::CLOTH, "SleepingTiles", Diagnostic::WHITE, 
+            StringCast(m_sleep->GetSleepingTiles()) + "/" + StringCast(m_sleep->GetTileCount()));
+
+        if(m_solver == IMPLICIT_SOLVER)
+        {
+            renderer.UpdateText(Diagnostic::CLOTH, "SolverIterations", 
+                Diagnostic::WHITE, StringCast(m_implicit->GetIterations()));
         }
+        else if(m_solver == PROJECTIVE_SOLVER)
+        {
+            renderer.UpdateText(Diagnostic::CLOTH, "Factorisations", 
+                Diagnostic::WHITE, StringCast(m_projective->GetFactorisations()));
+        }
+        else if(m_solver == MULTIGRID_SOLVER)
+        {
+            renderer.UpdateText(Diagnostic::CLOTH, "SolverLevels", 
+                Diagnostic::WHITE, StringCast(m_hierarchy->GetLevelCount()));
+        }
+        else if(m_solver == CHEBYSHEV_SOLVER)
+        {
+            renderer.UpdateText(Diagnostic::CLOTH, "SpectralRadius", 
+                Diagnostic::WHITE, StringCast(m_chebyshev->GetSpectralRadius()));
+        }
+
+        renderer.UpdateText(Diagnostic::CLOTH, 
+            "Smoothing", Diagnostic::WHITE, StringCast(m_generalSmoothing));
     }
+}
 
-    /* Connect neighbouring particles with springs
-    ------ x
-    |  |  |    Stretch/Compression: Horizontal/Vertical springs
-    -------    Shear: Cross springs
-    |  |  |    Bending: Link every second horizontal/vertical vertex
-    ------              
-    y */
+void Cloth::Reset()
+{
+    if(m_torn)
+    {
+        // Tearing only adds particles so rebuild the cloth as it started
+        if(IsMeshCloth())
+        {
+            CreateMeshCloth(m_spacing);
+        }
+        else
+        {
+            CreateCloth(m_detailLength, m_spacing);
+        }
+    }
+    else
+    {
+        for(int i = 0; i < m_particleCount; ++i)
+        {
+            Particle(m_particles, i).ResetPosition();
+        }
+        m_sleep->WakeAll(m_particles);
+        m_previousState = m_particles.positions;
+    }
+    UpdateVertexBuffer(1.0f);
+}
+
+void Cloth::ToggleTearing()
+{
+    m_tearing = !m_tearing;
+}
+
+void Cloth::ToggleAttachments()
+{
+    m_attach = !m_attach;
+}
+
+void Cloth::ToggleWind()
+{
+    m_blowing = !m_blowing;
+    m_sleep->WakeAll(m_particles);
+}
+
+void Cloth::ChangeSimulationLevel()
+{
+    // Cycles from following the camera through each fixed level
+    SetSimulationLevel(m_fixedLevel == MAX_SIMULATION_LEVEL ? NO_INDEX : m_fixedLevel + 1);
+}
+
+void Cloth::SetSimulationLevel(int level)
+{
+    m_fixedLevel = level;
+    if(m_fixedLevel != NO_INDEX)
+    {
+        ApplySimulationLevel(m_fixedLevel);
+    }
+}
+
+void Cloth::UpdateLevelOfDetail(const D3DXVECTOR3& cameraPosition)
+{
+    if(m_fixedLevel != NO_INDEX || IsMeshCloth() || m_particleCount == 0)
+    {
+        return;
+    }
+
+    D3DXVECTOR3 centre(0.0f, 0.0f, 0.0f);
+    for(int i = 0; i < m_particleCount; ++i)
+    {
+        centre += m_particles.positions[i];
+    }
+    centre /= static_cast<float>(m_particleCount);
+
+    // Only change once the distance is past the margin of the current
+    // level so a camera resting on the boundary does not keep switching
+    const D3DXVECTOR3 toCamera(cameraPosition - centre);
+    const float distance = D3DXVec3Length(&toCamera);
+    const float nearest = m_simulationLevel * LEVEL_DISTANCE * (1.0f - LEVEL_MARGIN);
+    const float furthest = (m_simulationLevel + 1) * LEVEL_DISTANCE * (1.0f + LEVEL_MARGIN);
+
+    if(distance < nearest || distance > furthest)
+    {
+        ApplySimulationLevel(min(static_cast<int>(distance / LEVEL_DISTANCE), 
+            MAX_SIMULATION_LEVEL));
+    }
+}
+
+void Cloth::ApplySimulationLevel(int level)
+{
+    // Torn particles no longer sit on the grid so cannot be carried over
+    if(IsMeshCloth() || m_torn)
+    {
+        return;
+    }
+
+    while(level > 0 && !CanSimulateLevel(level))
+    {
+        --level;
+    }
 
-    auto createSpring = [this](int i) -> int
+    if(level == m_simulationLevel)
     {
-        if(!m_springs[i+1].get())
-        {
-            m_springs[i+1].reset(new Spring());
-        }
-        return i+1;
-    };
+        return;
+    }
 
-    m_springCount = ((m_particleLength-1)*(((m_particleLength-2)*2)+2)) 
-        + (m_particleLength*(m_particleLength-1)) 
-        + (m_particleLength*(m_particleLength-2))
-        + ((m_particleLength-2)*m_particleLength)
-        + ((m_particleLength-1)*m_particleLength);
+    // Keep the state of the current grid to sample from once recreated
+    const int previousLength = m_particleLength;
+    const int previousStep = 1 << m_simulationLevel;
+    const std::vector<D3DXVECTOR3> positions(m_particles.positions);
+    const std::vector<D3DXVECTOR3> previousPositions(m_particles.previousPositions);
+    const std::vector<D3DXVECTOR3> previousState(m_previousState);
+    const std::vector<unsigned int> flags(m_particles.flags);
+    const std::vector<float> masses(m_particles.masses);
+
+    // Recreating the cloth forgets the pins hidden by a coarser grid
+    std::vector<std::pair<int, D3DXVECTOR3>> hiddenPins;
+    std::vector<int> heldPins;
+    hiddenPins.swap(m_hiddenPins);
+    heldPins.swap(m_heldPins);
+
+    m_simulationLevel = level;
+    CreateCloth(m_detailLength, m_spacing);
+    m_hiddenPins.swap(hiddenPins);
+    m_heldPins.swap(heldPins);
+
+    // Both grids span the same rendered vertices so each new particle on the previous
+    // grid keeps its state while the rest take the motion of the surface they fill in.
+    // Mass follows the area each particle covers so forces from the wind do not 
+    // push the particles of a coarser grid any harder than those of a finer one
+    const int step = 1 << m_simulationLevel;
+    const float scale = static_cast<float>(step) / static_cast<float>(previousStep);
+
+    int corners[4];
+    float weights[4];
 
-    m_springs.resize(m_springCount);
-    index = NO_INDEX;
     for(int x = 0; x < m_particleLength; ++x)
     {
         for(int y = 0; y < m_particleLength; ++y)
         {
-            //Last y doesn't have cross springs
-            if(y < m_particleLength-1)
+            const int index = (x*m_particleLength)+y;
+            const bool onPrevious = ((x*step) % previousStep) == 0 && 
+                ((y*step) % previousStep) == 0;
+
+            const int closest = ((((x*step) + (previousStep/2)) / previousStep) * previousLength) +
+                (((y*step) + (previousStep/2)) / previousStep);
+
+            // Particles only pinned to hold a hidden pin are released and chosen again below
+            const int vertex = (x*step*m_detailLength) + (y*step);
+            bool pinned = onPrevious && (flags[closest] & ParticleData::PINNED) != 0 &&
+                std::find(m_heldPins.begin(), m_heldPins.end(), vertex) == m_heldPins.end();
+
+            if(onPrevious)
             {
-                if(x < m_particleLength-1) //Don't create right cross if last x
+                m_particles.positions[index] = positions[closest];
+                m_particles.previousPositions[index] = previousPositions[closest];
+                m_previousState[index] = previousState[closest];
+            }
+            else
+            {
+                GetGridWeights(previousLength, x*scale, y*scale, corners, weights);
+
+                MakeZeroVector(m_particles.positions[index]);
+                MakeZeroVector(m_particles.previousPositions[index]);
+                MakeZeroVector(m_previousState[index]);
+                for(int i = 0; i < 4; ++i)
                 {
-                    index = createSpring(index);
-                    m_springs[index]->Initialise(*GetParticle(x,y),
-                        *GetParticle(x+1,y+1), index, Spring::SHEAR);
+                    m_particles.positions[index] += positions[corners[i]] * weights[i];
+                    m_particles.previousPositions[index] += previousPositions[corners[i]] * weights[i];
+                    m_previousState[index] += previousState[corners[i]] * weights[i];
                 }
 
-                if(x > 0) //Don't create left cross if first x
+                // A pin hidden by the coarser grid returns to where it sat on its surface
+                auto hidden = std::find_if(m_hiddenPins.begin(), m_hiddenPins.end(),
+                    [vertex](const std::pair<int, D3DXVECTOR3>& pin){ return pin.first == vertex; });
+
+                if(hidden != m_hiddenPins.end())
                 {
-                    index = createSpring(index);
-                    m_springs[index]->Initialise(*GetParticle(x,y),
-                        *GetParticle(x-1,y+1), index, Spring::SHEAR);
+                    m_particles.positions[index] += hidden->second;
+                    m_previousState[index] = m_particles.positions[index];
+                    m_hiddenPins.erase(hidden);
+                    pinned = true;
                 }
             }
 
-            //Last 2 xs doesn't have bending horizontal springs
-            if(x < m_particleLength-2)
-            {
-                index = createSpring(index);
-                m_springs[index]->Initialise(*GetParticle(x,y),
-                    *GetParticle(x+2,y), index, Spring::BEND);
-            }
+            Particle particle(m_particles, index);
+            particle.PinParticle(pinned);
+            particle.SelectParticle((flags[closest] & ParticleData::SELECTED) != 0);
+            particle.UpdateCollisionPosition();
+            m_particles.SetMass(index, masses[closest] * scale * scale);
+            SetParticleColor(particle);
+        }
+    }
 
-            //Last x doesn't have horizontal springs
-            if(x < m_particleLength-1)
-            {
-                index = createSpring(index);
-                m_springs[index]->Initialise(*GetParticle(x,y),
-                    *GetParticle(x+1,y), index, Spring::STRETCH);
-            }
+    // Pins between the particles of a coarser grid keep where they sit relative to 
+    // the coarser surface so they can be restored exactly on returning to a finer grid
+    for(int i = 0; i < previousLength*previousLength; ++i)
+    {
+        const int vertexX = (i / previousLength) * previousStep;
+        const int vertexY = (i % previousLength) * previousStep;
+        const int vertex = (vertexX*m_detailLength) + vertexY;
 
-            //Last 2ys doesn't have bending vertical springs
-            if(y < m_particleLength-2)
-            {
-                index = createSpring(index);
-                m_springs[index]->Initialise(*GetParticle(x,y),
-                    *GetParticle(x,y+2), index, Spring::BEND);
-            }
-            
-            //Last y doesn't have vertical springs
-            if(y < m_particleLength-1)
+        if((flags[i] & ParticleData::PINNED) && 
+           ((vertexX % step) != 0 || (vertexY % step) != 0) &&
+           std::find(m_heldPins.begin(), m_heldPins.end(), vertex) == m_heldPins.end())
+        {
+            GetGridWeights(m_particleLength, static_cast<float>(vertexX) / step,
+                static_cast<float>(vertexY) / step, corners, weights);
+
+            D3DXVECTOR3 offset(positions[i]);
+            for(int j = 0; j < 4; ++j)
             {
-                index = createSpring(index);
-                m_springs[index]->Initialise(*GetParticle(x,y),
-                    *GetParticle(x,y+1), index, Spring::STRETCH);
+                offset -= m_particles.positions[corners[j]] * weights[j];
             }
+            m_hiddenPins.push_back(std::make_pair(vertex, offset));
         }
     }
 
-    //Mesh Vertex Declaration
-    D3DVERTEXELEMENT9 VertexDec[] =
+    // Each hidden pin is held in place by pinning the closest particle to it
+    m_heldPins.clear();
+    for(const auto& pin : m_hiddenPins)
     {
-        { 0, 0,  D3DDECLTYPE_FLOAT3, D3DDECLMETHOD_DEFAULT, D3DDECLUSAGE_POSITION, 0 },
-        { 0, 12, D3DDECLTYPE_FLOAT3, D3DDECLMETHOD_DEFAULT, D3DDECLUSAGE_NORMAL,   0 },     
-        { 0, 24, D3DDECLTYPE_FLOAT2, D3DDECLMETHOD_DEFAULT, D3DDECLUSAGE_TEXCOORD, 0 },
-        D3DDECL_END()
-    };
+        const int x = ((pin.first / m_detailLength) + (step/2)) / step;
+        const int y = ((pin.first % m_detailLength) + (step/2)) / step;
+        const int index = (x*m_particleLength)+y;
 
-    //Create the mesh
-    if(m_mesh)
+        Particle particle(m_particles, index);
+        if(!particle.IsPinned())
+        {
+            particle.PinParticle(true);
+            SetParticleColor(particle);
+            m_heldPins.push_back((x*step*m_detailLength) + (y*step));
+        }
+    }
+    UpdateVertexBuffer(1.0f);
+}
+
+bool Cloth::CanTear() const
+{
+    // Implicit and projective solvers are prepared for a fixed set of springs
+    // and the subdivided or coarser index buffers do not follow the particle triangles
+    return m_tearing && m_quadVertices == 0 && !IsCoarse() && 
+        m_solver != IMPLICIT_SOLVER && m_solver != PROJECTIVE_SOLVER;
+}
+
+void Cloth::TearCloth()
+{
+    m_springs.FindOverstretched(m_particles, TEAR_LIMITS, m_overstretched);
+    if(m_overstretched.empty())
     {
-        m_mesh->Release();
-        m_mesh = nullptr;
+        return;
     }
 
-    if(FAILED(D3DXCreateMesh(triangleNumber, m_vertexData.size(),
-        D3DXMESH_VB_DYNAMIC | D3DXMESH_IB_MANAGED | D3DXMESH_32BIT,
-        VertexDec, m_engine->device(), &m_mesh)))
+    // Tearing moves springs around the buffer so keep the particles of each
+    std::vector<std::pair<int, int>> tears;
+    for(int i = 0; i < min(static_cast<int>(m_overstretched.size()), MAX_TEARS); ++i)
     {
-        m_mesh = nullptr;
-        ShowMessageBox("Cloth Mesh creation failed");
+        const Spring& spring = m_springs.GetSpring(m_overstretched[i]);
+        tears.push_back(std::make_pair(spring.particle1, spring.particle2));
     }
 
-    UpdateVertices();
+    if(!m_torn)
+    {
+        // Coarser grids are built from the untorn cloth and would hold it together
+        m_hierarchy->Initialise(m_particles, 0);
+        m_torn = true;
+    }
 
-    #pragma warning(disable: 4996)
+    const int vertexCapacity = static_cast<int>(m_vertexData.size());
+    std::vector<int> changedTriangles;
 
-    //Vertex Buffer
-    void* vertexBuffer = nullptr;
-    if(FAILED(m_mesh->LockVertexBuffer(0, &vertexBuffer)))
+    for(const auto& tear : tears)
     {
-        ShowMessageBox("Cloth Vertex buffer lock failed");
+        int spring = NO_INDEX;
+        for(int index : m_springs.GetParticleSprings(tear.first))
+        {
+            const Spring& connected = m_springs.GetSpring(index);
+            if(static_cast<int>(connected.particle1) == tear.second || 
+               static_cast<int>(connected.particle2) == tear.second)
+            {
+                spring = index;
+                break;
+            }
+        }
+
+        // An earlier tear this tick may have already moved the spring
+        if(spring == NO_INDEX)
+        {
+            continue;
+        }
+
+        // Try the particle with more triangles first as 
+        // the other may be on an edge with nothing to separate
+        int p1 = tear.first;
+        int p2 = tear.second;
+        if(m_particleTriangles[p1].size() < m_particleTriangles[p2].size())
+        {
+            std::swap(p1, p2);
+        }
+
+        if(!SplitParticle(p1, p2, changedTriangles) && 
+           !SplitParticle(p2, p1, changedTriangles))
+        {
+            m_springs.RemoveSpring(spring);
+        }
     }
-    std::copy(m_vertexData.begin(), m_vertexData.end(), (MeshVertex*)vertexBuffer);
-    m_mesh->UnlockVertexBuffer();
 
-    //Index Buffer
-    void* indexdata = nullptr;
-    if(FAILED(m_mesh->LockIndexBuffer(0, &indexdata)))
+    m_springCount = m_springs.GetCount();
+    m_rebuildAttachments = true;
+
+    if(static_cast<int>(m_vertexData.size()) != vertexCapacity)
     {
-        ShowMessageBox("Cloth Index buffer lock failed");
+        CreateMesh();
+    }
+    else
+    {
+        UpdateIndexBuffer(changedTriangles);
     }
-    std::copy(m_indexData.begin(), m_indexData.end(), (DWORD*)indexdata);
-    m_mesh->UnlockIndexBuffer();
 }
 
-void Cloth::Draw(const D3DXVECTOR3& cameraPos, const Matrix& projection, const Matrix& view)
+bool Cloth::SplitParticle(int index, int other, std::vector<int>& changedTriangles)
 {
-    m_shader->SetTechnique(DxConstant::DefaultTechnique);
-    m_shader->SetFloatArray(DxConstant::CameraPosition, &(cameraPos.x), 3);
-    m_shader->SetTexture(DxConstant::DiffuseTexture, m_texture);
-    m_engine->sendLightsToShader(m_shader);
-
-    D3DXMATRIX worldInvTrans;
-    D3DXMATRIX worldViewProj = GetMatrix() * view.GetMatrix() * projection.GetMatrix();
-    D3DXMatrixInverse(&worldInvTrans, 0, &GetMatrix());
-    D3DXMatrixTranspose(&worldInvTrans, &worldInvTrans);
+    // Split along the plane through the particle facing the other particle
+    // of the torn spring; triangles on the side of the other particle move
+    const D3DXVECTOR3 position(m_particles.positions[index]);
+    const D3DXVECTOR3 direction(m_particles.positions[other] - position);
+    auto isTornSide = [&position, &direction](const D3DXVECTOR3& point) -> bool
+    {
+        const D3DXVECTOR3 offset(point - position);
+        return D3DXVec3Dot(&offset, &direction) > 0.0f;
+    };
 
-    m_shader->SetMatrix(DxConstant::WorldInverseTranspose, &worldInvTrans);
-    m_shader->SetMatrix(DxConstant::WordViewProjection, &worldViewProj);
-    m_shader->SetMatrix(DxConstant::World, &GetMatrix());
+    std::vector<int> kept;
+    std::vector<int> moved;
+    for(int triangle : m_particleTriangles[index])
+    {
+        D3DXVECTOR3 center(0.0f, 0.0f, 0.0f);
+        for(int i = 0; i < POINTS_IN_FACE; ++i)
+        {
+            center += m_particles.positions[m_triangles[(triangle*POINTS_IN_FACE)+i]];
+        }
+        center /= static_cast<float>(POINTS_IN_FACE);
+        (isTornSide(center) ? moved : kept).push_back(triangle);
+    }
 
-    UINT nPasses = 0;
-    m_shader->Begin(&nPasses, 0);
-    for(UINT iPass = 0; iPass < nPasses; ++iPass)
+    if(kept.empty() || moved.empty())
     {
-        m_shader->BeginPass(iPass);
-        m_mesh->DrawSubset(0);
-        m_shader->EndPass();
+        return false;
     }
-    m_shader->End();
-}
 
-void Cloth::SetHandleMode(bool set)
-{
-    m_handleMode = set;
-    ChangeRow(m_selectedRow, m_handleMode);
-}
+    // Record the side of each surrounding particle; 
+    // those along the tear touch triangles on both sides
+    enum { KEPT = 1, MOVED = 2 };
+    std::vector<std::pair<int, int>> sides;
+    auto getSide = [&sides](int particle) -> int
+    {
+        for(const auto& side : sides)
+        {
+            if(side.first == particle)
+            {
+                return side.second;
+            }
+        }
+        return 0;
+    };
 
-void Cloth::SetVertexVisibility(bool draw)
-{
-    m_drawVisualParticles = draw;
-}
+    auto addSides = [this, &sides, index](const std::vector<int>& triangles, int side)
+    {
+        for(int triangle : triangles)
+        {
+            for(int i = 0; i < POINTS_IN_FACE; ++i)
+            {
+                const int particle = m_triangles[(triangle*POINTS_IN_FACE)+i];
+                if(particle != index)
+                {
+                    auto itr = std::find_if(sides.begin(), sides.end(), 
+                        [particle](const std::pair<int, int>& p){ return p.first == particle; });
+
+                    if(itr == sides.end())
+                    {
+                        sides.push_back(std::make_pair(particle, side));
+                    }
+                    else
+                    {
+                        itr->second |= side;
+                    }
+                }
+            }
+        }
+    };
 
-void Cloth::SetCollisionVisibility(bool draw)
-{
-    m_drawColParticles = draw;
-}
+    addSides(kept, KEPT);
+    addSides(moved, MOVED);
 
-void Cloth::UnpinCloth()
-{
-    auto unpinParticle = [this](const ParticlePtr& part)
-    { 
-        part->PinParticle(false); 
-        SetParticleColor(part);
-    };
-    std::for_each(m_particles.begin(), m_particles.end(), unpinParticle);
-}
+    m_sleep->WakeParticle(m_particles, index);
+    const int split = AddParticle(index);
 
-void Cloth::AddForce(const D3DXVECTOR3& force)
-{
-    for(const ParticlePtr& particle : m_particles)
+    for(int triangle : moved)
     {
-        particle->AddForce(force);
+        for(int i = triangle*POINTS_IN_FACE; i < (triangle+1)*POINTS_IN_FACE; ++i)
+        {
+            if(m_triangles[i] == index)
+            {
+                m_triangles[i] = split;
+                m_indexData[i] = split;
+            }
+        }
+        changedTriangles.push_back(triangle);
     }
-}
-
-void Cloth::PreCollisionUpdate(float deltatime)
-{
-    UpdateDiagnostics();
+    m_particleTriangles[index] = kept;
+    m_particleTriangles[split] = moved;
+    m_bending->SplitParticle(index, split, moved, m_triangles);
 
-    // Move cloth down slowly
-    if(m_simulation)
+    // Springs follow the side of the particle they connect to
+    const std::vector<int> springs(m_springs.GetParticleSprings(index));
+    for(int spring : springs)
     {
-        AddForce(m_gravity*m_timestepSquared*deltatime);
+        const Spring& connected = m_springs.GetSpring(spring);
+        const int neighbour = static_cast<int>(connected.particle1) == index ?
+            connected.particle2 : connected.particle1;
+
+        const int side = getSide(neighbour);
+        if(side == MOVED || (side == 0 && isTornSide(m_particles.positions[neighbour])))
+        {
+            m_springs.ReplaceParticle(spring, index, split);
+        }
     }
-    
-    // Solve Springs
-    for(int j = 0; j < m_springIterations; ++j)
+
+    // Springs joining surrounding particles on opposite sides hold the tear closed
+    std::vector<int> crossing;
+    for(const auto& side : sides)
     {
-        for(const SpringPtr& spring : m_springs)
+        if(side.second == KEPT)
         {
-            spring->SolveSpring(m_timestep);
+            for(int spring : m_springs.GetParticleSprings(side.first))
+            {
+                const Spring& connected = m_springs.GetSpring(spring);
+                const int neighbour = static_cast<int>(connected.particle1) == side.first ?
+                    connected.particle2 : connected.particle1;
+
+                if(getSide(neighbour) == MOVED)
+                {
+                    crossing.push_back(spring);
+                }
+            }
         }
     }
 
-    // Updating particle positions
-    for(const ParticlePtr& particle : m_particles)
+    // Removing a spring only moves those after it in the buffer
+    std::sort(crossing.begin(), crossing.end(), std::greater<int>());
+    for(int spring : crossing)
     {
-        particle->PreCollisionUpdate(m_damping, m_timestepSquared);
+        m_springs.RemoveSpring(spring);
     }
+    return true;
 }
 
-void Cloth::UpdateDiagnostics()
+int Cloth::AddParticle(int source)
 {
-    auto& renderer = *m_engine->diagnostic();
-    m_particles[m_diagnosticParticle]->UpdateDiagnostics(renderer);
-
-    if(renderer.AllowDiagnostics(Diagnostic::CLOTH))
+    const int index = m_particleCount++;
+    m_particles.Resize(m_particleCount);
+    const bool firstInitialisation = !m_particles.collisions[index];
+
+    Particle particle(m_particles, index);
+    particle.Initialise(m_engine, m_particles.positions[source], 
+        m_particles.uvs[source], *m_template);
+
+    // Carry over the motion and state of the particle torn from
+    m_particles.initialPositions[index] = m_particles.initialPositions[source];
+    m_particles.previousPositions[index] = m_particles.previousPositions[source];
+    m_particles.accelerations[index] = m_particles.accelerations[source];
+    m_particles.flags[index] = m_particles.flags[source];
+    m_particles.SetMass(index, m_particles.masses[source]);
+    SetParticleColor(particle);
+
+    if(firstInitialisation)
     {
-        std::for_each(m_springs.begin(), m_springs.end(), 
-            [this, &renderer](const SpringPtr& spring)
-            { 
-                spring->UpdateDiagnostic(renderer); 
-            });
+        m_engine->octree()->AddObject(particle.GetCollisionMesh());
+    }
 
-        renderer.UpdateText(Diagnostic::CLOTH, 
-            "ParticleCount", Diagnostic::WHITE, StringCast(m_particleCount));
+    m_previousState.push_back(m_previousState[source]);
+    m_particleTriangles.emplace_back();
+    m_springs.AddParticle();
+    m_bending->AddParticle();
+    m_sleep->AddParticle(index, source);
 
-        renderer.UpdateText(Diagnostic::CLOTH, 
-            "Smoothing", Diagnostic::WHITE, StringCast(m_generalSmoothing));
+    // Leave spare vertices so the mesh is only recreated every few tears
+    if(m_particleCount > static_cast<int>(m_vertexData.size()))
+    {
+        m_vertexData.resize(m_particleCount + (m_particleCount / 4));
     }
+    return index;
 }
 
-void Cloth::Reset()
+void Cloth::UpdateIndexBuffer(const std::vector<int>& triangles)
 {
-    for(const ParticlePtr& particle : m_particles)
+    void* indexdata = nullptr;
+    if(FAILED(m_mesh->LockIndexBuffer(0, &indexdata)))
+    {
+        ShowMessageBox("Cloth Index buffer lock failed");
+        return;
+    }
+
+    DWORD* indices = static_cast<DWORD*>(indexdata);
+    for(int triangle : triangles)
     {
-        particle->ResetPosition();
+        for(int i = triangle*POINTS_IN_FACE; i < (triangle+1)*POINTS_IN_FACE; ++i)
+        {
+            indices[i] = m_indexData[i];
+        }
     }
-    UpdateVertexBuffer();
+    m_mesh->UnlockIndexBuffer();
 }
 
-Cloth::ParticlePtr& Cloth::GetParticle(int row, int column)
+void Cloth::SelectParticleForDiagnostics(int index)
 {
-    return m_particles[(column * m_particleLength) + row];
+    m_diagnosticParticle = index;
+    m_particles.collisions[m_diagnosticParticle]->SetRenderSolverDiagnostics(true);
+}
+
+Particle Cloth::GetParticle(int row, int column)
+{
+    return Particle(m_particles, (column * m_particleLength) + row);
 }
 
 void Cloth::DrawCollisions(const Matrix& projection, const Matrix& view)
 {
     if(m_drawColParticles)
     {
-        for(const ParticlePtr& particle : m_particles)
+        for(int i = 0; i < m_particleCount; ++i)
         {
-            particle->DrawCollisionMesh(projection, view);
+            Particle(m_particles, i).DrawCollisionMesh(projection, view);
         }
     }
 
     if(m_drawVisualParticles)
     {
-        for(unsigned int i = 0; i < m_particles.size(); ++i)
+        for(int i = 0; i < m_particleCount; ++i)
         {
             // Draw visual particles at smoothed position
-            m_particles[i]->DrawVisualMesh(projection, 
+            Particle(m_particles, i).DrawVisualMesh(projection, 
                 view, m_vertexData[i].position);
         }
     }
@@ -483,7 +1640,7 @@ bool Cloth::MousePickingTest(Picking& input)
         int indexChosen = NO_INDEX;
         for(int index = 0; index < m_particleCount; ++index)
         {
-            const CollisionMesh& mesh = m_particles[index]->GetCollisionMesh();
+            const CollisionMesh& mesh = *m_particles.collisions[index];
             const Geometry& geometry = *mesh.GetGeometry();
 
             //tweak the collision mesh to compensate for any smoothing on the cloth
@@ -510,17 +1667,25 @@ bool Cloth::MousePickingTest(Picking& input)
     return false;
 }
 
-void Cloth::SetParticleColor(const Cloth::ParticlePtr& particle)
+void Cloth::SetParticleColor(Particle& particle)
 {
-    ParticleColors color = (particle->IsPinned() ? PINNED : 
-        (particle->IsSelected() && m_handleMode ? SELECTED : NORMAL));
-    particle->SetColor(m_colors[color]);
+    ParticleColors color = (particle.IsPinned() ? PINNED : 
+        (particle.IsSelected() && m_handleMode ? SELECTED : NORMAL));
+    particle.SetColor(m_colors[color]);
 }
 
 void Cloth::SelectParticle(int index)
 {
-    m_particles[index]->PinParticle(!m_particles[index]->IsPinned());
-    SetParticleColor(m_particles[index]);
+    m_sleep->WakeParticle(m_particles, index);
+    Particle particle(m_particles, index);
+    particle.PinParticle(!particle.IsPinned());
+    SetParticleColor(particle);
+    m_rebuildAttachments = true;
+}
+
+void Cloth::SetParticleMass(int index, float mass)
+{
+    m_particles.SetMass(index, mass);
 }
 
 void Cloth::MovePinnedRow(float right, float up, float forward)
@@ -528,11 +1693,13 @@ void Cloth::MovePinnedRow(float right, float up, float forward)
     if(m_handleMode)
     {
         D3DXVECTOR3 direction(right, up, forward);
-        for(const ParticlePtr& particle : m_particles)
+        for(int i = 0; i < m_particleCount; ++i)
         {
-            if(particle->IsSelected())
+            Particle particle(m_particles, i);
+            if(particle.IsSelected())
             { 
-                particle->AddForce(direction); 
+                m_sleep->WakeParticle(m_particles, i);
+                particle.AddForce(direction); 
             } 
         }
     }
@@ -550,6 +1717,12 @@ void Cloth::ChangeRow(int row)
 
 void Cloth::ChangeRow(int row, bool select)
 {
+    // Rows only exist for the grid
+    if(IsMeshCloth())
+    {
+        return;
+    }
+
     int index = 0;
     int counter = 0;
     std::function<void(void)> getIndexFn = nullptr;
@@ -573,8 +1746,9 @@ void Cloth::ChangeRow(int row, bool select)
     for(; counter < m_particleLength; ++counter)
     {
         getIndexFn();
-        m_particles[index]->SelectParticle(select);
-        SetParticleColor(m_particles[index]);
+        Particle particle(m_particles, index);
+        particle.SelectParticle(select);
+        SetParticleColor(particle);
     }
 }
 
@@ -582,14 +1756,25 @@ void Cloth::SetSpacing(double size)
 {
     if(size != m_spacing)
     {
-        CreateCloth(m_particleLength, static_cast<float>(size));
+        if(IsMeshCloth())
+        {
+            CreateMeshCloth(static_cast<float>(size));
+        }
+        else
+        {
+            CreateCloth(m_detailLength, static_cast<float>(size));
+        }
     }
 }
 
 void Cloth::SetVertexRows(double number)
 {
-    if(number != m_particleLength)
+    // Changing the rows always returns a mesh cloth to the grid
+    if(number != m_detailLength || IsMeshCloth())
     {
+        m_meshPositions.clear();
+        m_meshUvs.clear();
+        m_meshTriangles.clear();
         CreateCloth(static_cast<int>(number), m_spacing);
     }
 }
@@ -597,6 +1782,7 @@ void Cloth::SetVertexRows(double number)
 void Cloth::SetIterations(double iterations)
 {
     m_springIterations = static_cast<int>(iterations);
+    m_chebyshev->SetSchedule(GetIterationLimit(), GetSolverRows());
 }
 
 void Cloth::SetTimeStep(double timestep)
@@ -617,7 +1803,7 @@ double Cloth::GetIterations() const
 
 double Cloth::GetVertexRows() const
 {
-    return m_particleLength;
+    return m_detailLength;
 }
 
 double Cloth::GetSpacing() const
@@ -625,27 +1811,48 @@ double Cloth::GetSpacing() const
     return m_spacing;
 }
 
-std::vector<Cloth::ParticlePtr>& Cloth::GetParticles()
+ParticleData& Cloth::GetParticles()
 {
     return m_particles;
 }
 
 void Cloth::PostCollisionUpdate()
 {
-    // Update the collision mesh last after all movement has been decided
-    for(const ParticlePtr& particle : m_particles)
+    // Particles at rest have no delta to filter so all are filtered in one pass
+    m_particles.FilterPositions();
+
+    // Update the collision mesh last after all movement has been decided;
+    // sleeping particles are left as they were unless a collision moved them
+    for(int i = 0; i < m_particleCount; ++i)
+    {
+        if(!(m_particles.flags[i] & ParticleData::SLEEPING) || 
+            m_particles.positions[i] != m_previousState[i])
+        {
+            Particle(m_particles, i).PostCollisionUpdate();
+        }
+    }
+
+    // Tearing adds particles and changes the mesh so is done here
+    // rather than alongside the other cloths before collisions
+    if(CanTear() && !m_sleep->IsAsleep())
     {
-        particle->PostCollisionUpdate();
+        TearCloth();
     }
 
-    UpdateVertexBuffer();
+    // Gusts change the force on a resting cloth without moving it first so
+    // nothing may fall asleep while the wind is blowing or it would stay frozen
+    if(IsPositionBased() && !m_blowing)
+    {
+        m_sleep->Update(m_particles, m_previousState);
+    }
 }
 
-bool Cloth::UpdateVertexBuffer()
+bool Cloth::UpdateVertexBuffer(float interpolation)
 {
-    UpdateVertices();
+    UpdateVertices(interpolation);
     SmoothCloth();
     UpdateNormals();
+    UpdateDetailVertices();
     UpdateSubdividedVertices();
 
     //Lock the vertex buffer
@@ -658,7 +1865,8 @@ bool Cloth::UpdateVertexBuffer()
 
     //Copy over values 
     #pragma warning(disable: 4996)
-    std::copy(m_vertexData.begin(), m_vertexData.end(), (MeshVertex*)vertexBuffer);
+    const std::vector<MeshVertex>& vertices = GetRenderedVertices();
+    std::copy(vertices.begin(), vertices.end(), (MeshVertex*)vertexBuffer);
 
     //unlock vertex buffer
     m_mesh->UnlockVertexBuffer();
@@ -680,57 +1888,84 @@ void Cloth::ChangeSmoothing(bool increase)
     m_generalSmoothing = max(m_generalSmoothing, 0.0f);
 }
 
-void Cloth::UpdateVertices()
+int Cloth::GetIterationLimit() const
+{
+    return m_adaptiveIterations ? MAX_ADAPTIVE_ITERATIONS : m_springIterations;
+}
+
+void Cloth::ToggleAdaptiveIterations()
+{
+    m_adaptiveIterations = !m_adaptiveIterations;
+    m_chebyshev->SetSchedule(GetIterationLimit(), GetSolverRows());
+}
+
+void Cloth::ChangeSolver()
+{
+    SetSolver(static_cast<Solver>((m_solver + 1) % MAX_SOLVERS));
+}
+
+void Cloth::SetSolver(Solver solver)
+{
+    m_solver = solver;
+
+    // Only position based solvers skip sleeping particles
+    m_sleep->WakeAll(m_particles);
+
+    // Tearing changes the springs after these solvers were prepared
+    if(m_torn)
+    {
+        InitialiseLinearSolvers();
+    }
+}
+
+const std::string& Cloth::GetSolverName(Solver solver)
+{
+    return SOLVER_NAMES[solver];
+}
+
+float Cloth::MeasureStretchError(float& rmsError) const
+{
+    return m_springs.MeasureError(m_particles, *m_engine->threadpool(), rmsError);
+}
+
+void Cloth::UpdateVertices(float interpolation)
 {
-    int index = NO_INDEX;
     D3DXVECTOR3 normal(0.0f, 0.0f, 0.0f);
 
-    for(int x = 0; x < m_particleLength; ++x)
+    for(int index = 0; index < m_particleCount; ++index)
     {
-        for(int y = 0; y < m_particleLength; ++y)
-        {
-            index = (x*m_particleLength)+y;
-            m_vertexData[index].normal = normal;
-            m_vertexData[index].uvs = m_particles[index]->GetUVs();
-            m_vertexData[index].position = m_particles[index]->GetPosition();
-        }
+        m_vertexData[index].normal = normal;
+        m_vertexData[index].uvs = m_particles.uvs[index];
+        const D3DXVECTOR3& previous = m_previousState[index];
+        m_vertexData[index].position = previous + 
+            ((m_particles.positions[index] - previous) * interpolation);
     }
 }
 
 void Cloth::UpdateNormals()
 {
     D3DXVECTOR3 normal;
-    int p1, p2, p3, p4;
+    int p1, p2, p3;
 
-    for(int x = 0; x < m_particleLength-1; ++x)
+    for(unsigned int i = 0; i < m_triangles.size(); i += POINTS_IN_FACE)
     {
-        for(int y = 0; y < m_particleLength-1; ++y)
-        {
-            p1 = (x*m_particleLength)+y;
-            p2 = ((x+1)*m_particleLength)+y;
-            p3 = (x*m_particleLength)+y+1;
-            p4 = ((x+1)*m_particleLength)+y+1;
+        p1 = m_triangles[i];
+        p2 = m_triangles[i+1];
+        p3 = m_triangles[i+2];
 
-            normal = CalculateNormal(m_vertexData[p2].position,
-                m_vertexData[p1].position, m_vertexData[p3].position);
+        normal = CalculateNormal(m_vertexData[p1].position,
+            m_vertexData[p2].position, m_vertexData[p3].position);
 
-            m_vertexData[p2].normal += normal;
-            m_vertexData[p1].normal += normal;
-            m_vertexData[p3].normal += normal;
-
-            normal = CalculateNormal(m_vertexData[p4].position,
-                m_vertexData[p2].position, m_vertexData[p3].position);
-
-            m_vertexData[p4].normal += normal;
-            m_vertexData[p2].normal += normal;
-            m_vertexData[p3].normal += normal;
-        }
+        m_vertexData[p1].normal += normal;
+        m_vertexData[p2].normal += normal;
+        m_vertexData[p3].normal += normal;
     }
 }
 
 void Cloth::SmoothCloth()
 {
-    if(m_generalSmoothing > 0.0f)
+    // Smoothing averages the diagonal grid neighbours so only applies to the grid
+    if(m_generalSmoothing > 0.0f && !IsMeshCloth())
     {
         int index = NO_INDEX;
         D3DXVECTOR3 halfp1, halfp2;
@@ -743,7 +1978,7 @@ void Cloth::SmoothCloth()
             for(int y = 1; y < m_particleLength-1; ++y)
             {
                 index = (x*m_particleLength)+y;
-                if(m_particles[index]->RequiresSmoothing())
+                if(Particle(m_particles, index).RequiresSmoothing())
                 {
                     p1 = ((x+1)*m_particleLength)+y+1;
                     p2 = ((x+1)*m_particleLength)+y-1;
@@ -765,43 +2000,80 @@ void Cloth::SmoothCloth()
     }
 }
 
+void Cloth::UpdateDetailVertices()
+{
+    if(IsCoarse())
+    {
+        // Each rendered vertex blends the four simulated vertices around it,
+        // generalising the single vertex subdivision adds to the centre of a quad
+        const float scale = static_cast<float>(m_particleLength-1) / 
+            static_cast<float>(m_detailLength-1);
+
+        int corners[4];
+        float weights[4];
+
+        for(int x = 0; x < m_detailLength; ++x)
+        {
+            for(int y = 0; y < m_detailLength; ++y)
+            {
+                GetGridWeights(m_particleLength, x*scale, y*scale, corners, weights);
+
+                MeshVertex& vertex = m_detailData[(x*m_detailLength)+y];
+                vertex.position = m_vertexData[corners[0]].position * weights[0];
+                vertex.normal = m_vertexData[corners[0]].normal * weights[0];
+                vertex.uvs = m_vertexData[corners[0]].uvs * weights[0];
+
+                for(int i = 1; i < 4; ++i)
+                {
+                    vertex.position += m_vertexData[corners[i]].position * weights[i];
+                    vertex.normal += m_vertexData[corners[i]].normal * weights[i];
+                    vertex.uvs += m_vertexData[corners[i]].uvs * weights[i];
+                }
+            }
+        }
+    }
+}
+
 void Cloth::UpdateSubdividedVertices()
 {
-    if(m_subdivideCloth)
+    if(m_quadVertices > 0)
     {
+        std::vector<MeshVertex>& vertices = GetRenderedVertices();
+        const int vertexCount = m_detailLength*m_detailLength;
+
         int quad = 0;
         int quadindex = 0;
         D3DXVECTOR2 halfuv1, halfuv2;
         D3DXVECTOR3 halfp1, halfp2;
         int p1, p2, p3, p4;
 
-        for(int x = 0; x < m_particleLength-1; ++x)
+        for(int x = 0; x < m_detailLength-1; ++x)
         {
-            for(int y = 0; y < m_particleLength-1; ++y)
+            for(int y = 0; y < m_detailLength-1; ++y)
             {
-                p1 = (x*m_particleLength)+y;
-                p2 = ((x+1)*m_particleLength)+y;
-                p3 = (x*m_particleLength)+y+1;
-                p4 = ((x+1)*m_particleLength)+y+1;
-                quadindex = m_particleCount + quad;
+                p1 = (x*m_detailLength)+y;
+                p2 = ((x+1)*m_detailLength)+y;
+                p3 = (x*m_detailLength)+y+1;
+                p4 = ((x+1)*m_detailLength)+y+1;
+                quadindex = vertexCount + quad;
 
-                halfp1 = (m_vertexData[p1].position
-                    + m_vertexData[p4].position) * 0.5f;
+                halfp1 = (vertices[p1].position
+                    + vertices[p4].position) * 0.5f;
 
-                halfp2 = (m_vertexData[p2].position
-                    + m_vertexData[p3].position) * 0.5f;
+                halfp2 = (vertices[p2].position
+                    + vertices[p3].position) * 0.5f;
 
-                halfuv1 = (m_vertexData[p1].uvs
-                    + m_vertexData[p4].uvs) * 0.5f;
+                halfuv1 = (vertices[p1].uvs
+                    + vertices[p4].uvs) * 0.5f;
 
-                halfuv2 = (m_vertexData[p2].uvs
-                    + m_vertexData[p3].uvs) * 0.5f;
+                halfuv2 = (vertices[p2].uvs
+                    + vertices[p3].uvs) * 0.5f;
 
-                m_vertexData[quadindex].position = (halfp1 + halfp2) * 0.5f;
-                m_vertexData[quadindex].uvs = (halfuv1 + halfuv2) * 0.5f;
-                m_vertexData[quadindex].normal = (m_vertexData[p2].normal 
-                    + m_vertexData[p1].normal + m_vertexData[p3].normal 
-                    + m_vertexData[p4].normal) * 0.25f;
+                vertices[quadindex].position = (halfp1 + halfp2) * 0.5f;
+                vertices[quadindex].uvs = (halfuv1 + halfuv2) * 0.5f;
+                vertices[quadindex].normal = (vertices[p2].normal 
+                    + vertices[p1].normal + vertices[p3].normal 
+                    + vertices[p4].normal) * 0.25f;
 
                 quad += 1;
             }
@@ -7,11 +7,19 @@
 #include "callbacks.h"
 #include "pickablemesh.h"
 #include "geometry.h"
+#include "particle.h"
+#include "spring.h"
 
 class Picking;
 class CollisionMesh;
-class Particle;
-class Spring;
+class ImplicitSolver;
+class ProjectiveSolver;
+class HierarchicalSolver;
+class ChebyshevAccelerator;
+class SleepTracker;
+class LongRangeAttachments;
+class BendingConstraints;
+class WindField;
 
 /**
 * Dynamic mesh with soft body physics
@@ -20,14 +28,27 @@ class Cloth : public PickableMesh, public Transform
 {
 public:
 
-    typedef std::unique_ptr<Particle> ParticlePtr;
-    typedef std::unique_ptr<Spring> SpringPtr;
+    /**
+    * Methods available for solving the cloth springs
+    */
+    enum Solver
+    {
+        SERIAL_SOLVER,    ///< Springs solved one after the other
+        PARALLEL_SOLVER,  ///< Independent groups of springs split across threads
+        XPBD_SOLVER,      ///< Compliant constraints solved over substeps
+        IMPLICIT_SOLVER,  ///< Backward euler integration of the springs
+        PROJECTIVE_SOLVER,///< Projective dynamics with a prefactored global step
+        MULTIGRID_SOLVER, ///< Springs relaxed on coarser grids of the cloth
+        CHEBYSHEV_SOLVER, ///< Parallel relaxation with chebyshev acceleration
+        MAX_SOLVERS
+    };
 
     /**
     * Constructor; loads the cloth mesh
     * @param engine Callbacks from the rendering engine
+    * @param offset Amount to move the cloth from its starting position
     */
-    explicit Cloth(EnginePtr engine);
+    Cloth(EnginePtr engine, const D3DXVECTOR3& offset);
 
     /**
     * Destructor
@@ -60,9 +81,15 @@ public:
     /**
     * Updates the cloth state before collision solving
     * @param deltatime The time passed since last frame in seconds
+    * @note only touches this cloth so can be called alongside other cloths
     */
     void PreCollisionUpdate(float deltatime);
 
+    /**
+    * Draws and updates the diagnostics for the cloth
+    */
+    void UpdateDiagnostics();
+
     /**
     * Resets the cloth to its initial state
     */
@@ -71,7 +98,7 @@ public:
     /**
     * @param simulating Set whether the cloth is simulating
     */
-    void SetSimulation(bool simulating) { m_simulation = simulating; }
+    void SetSimulation(bool simulating);
 
     /**
     * @return whether the cloth is simulating
@@ -100,6 +127,25 @@ public:
     */
     double GetVertexRows() const;
 
+    /**
+    * Replaces the grid with a triangle mesh; vertices sharing a position
+    * are welded and the mesh is scaled so its average edge is the spacing
+    * @param path The path of the mesh to load
+    * @param errorBuffer The error buffer to fill if something fails
+    * @return whether loading succeeded
+    */
+    bool LoadMesh(const std::string& path, std::string& errorBuffer);
+
+    /**
+    * @return whether the cloth is a loaded triangle mesh rather than a grid
+    */
+    bool IsMeshCloth() const;
+
+    /**
+    * @return whether every particle of the cloth is asleep
+    */
+    bool IsAsleep() const;
+
     /**
     * Sets the particle solver iteration amount
     * @param iterations The iterations to set to
@@ -123,9 +169,9 @@ public:
     double GetTimeStep() const;
 
     /**
-    * @return the container of cloth particles
+    * @return the data for all cloth particles
     */
-    std::vector<ParticlePtr>& GetParticles();
+    ParticleData& GetParticles();
     
     /**
     * @param draw Set whether the vertices are visible or not
@@ -165,17 +211,86 @@ public:
     */
     void SelectParticle(int index);
 
+    /**
+    * Sets the mass of a particle to weight parts of the cloth such as a hem
+    * @param index The particle to change
+    * @param mass The mass in kg of the particle
+    */
+    void SetParticleMass(int index, float mass);
+
     /**
     * Whether to increase or decrease the amount of
     * general overall smoothing for the cloth
     */
     void ChangeSmoothing(bool increase);
 
+    /**
+    * Switches to the next method available for solving the springs
+    */
+    void ChangeSolver();
+
+    /**
+    * @param solver The method to use for solving the springs
+    */
+    void SetSolver(Solver solver);
+
+    /**
+    * @param solver The method for solving the springs
+    * @return the name of the method
+    */
+    static const std::string& GetSolverName(Solver solver);
+
+    /**
+    * Toggles whether the springs are relaxed until they are within a
+    * tolerance of their rest distance rather than a set amount of iterations
+    */
+    void ToggleAdaptiveIterations();
+
+    /**
+    * Toggles whether springs stretched too far tear the cloth
+    */
+    void ToggleTearing();
+
+    /**
+    * Toggles whether particles are tethered to their closest pinned particle
+    */
+    void ToggleAttachments();
+
+    /**
+    * Toggles whether the wind blows on the cloth
+    */
+    void ToggleWind();
+
+    /**
+    * Switches between following the camera distance and each fixed simulation level
+    */
+    void ChangeSimulationLevel();
+
+    /**
+    * Sets how much coarser the simulated grid is than the rendered grid
+    * @param level Times the simulated rows are halved or NO_INDEX to follow the camera
+    */
+    void SetSimulationLevel(int level);
+
+    /**
+    * Chooses the simulation level from the distance to the camera if following it
+    * @param cameraPosition The world position of the camera
+    */
+    void UpdateLevelOfDetail(const D3DXVECTOR3& cameraPosition);
+
+    /**
+    * Measures how far the springs are from their rest distance
+    * @param rmsError Filled with the root mean square relative error
+    * @return the largest relative error of any spring
+    */
+    float MeasureStretchError(float& rmsError) const;
+
     /**
     * Copies smoothed vertex data over to directX vertex buffer 
+    * @param interpolation The amount between the previous and current physics step
     * @return whether the call succeeded or not
     */
-    bool UpdateVertexBuffer();
+    bool UpdateVertexBuffer(float interpolation);
 
     /**
     * Updates anything that requires collision update before
@@ -192,9 +307,110 @@ private:
     void CreateCloth(int rows, float spacing);
 
     /**
-    * Draws and updates the diagnostics for the cloth
+    * Recreates the cloth from the loaded triangle mesh
+    * @param spacing The average spacing between vertices
     */
-    void UpdateDiagnostics();
+    void CreateMeshCloth(float spacing);
+
+    /**
+    * Recreates the grid simulated at the given level and carries
+    * the current state of the cloth over onto the new particles
+    * @param level Times the simulated rows are halved from the rendered rows
+    * @note falls back to a finer level if the rows do not divide evenly
+    */
+    void ApplySimulationLevel(int level);
+
+    /**
+    * @param level Times the simulated rows are halved from the rendered rows
+    * @return the rows of the simulated grid at the level
+    */
+    int GetLevelRows(int level) const;
+
+    /**
+    * @param level Times the simulated rows are halved from the rendered rows
+    * @return whether the rendered rows halve evenly into enough rows at the level
+    */
+    bool CanSimulateLevel(int level) const;
+
+    /**
+    * @return whether the simulated grid is coarser than the rendered grid
+    */
+    bool IsCoarse() const;
+
+    /**
+    * @return the vertices copied to the vertex buffer
+    */
+    std::vector<MeshVertex>& GetRenderedVertices();
+
+    /**
+    * Initialises the particles of the cloth
+    * @param positions The starting position of each particle
+    * @param uvs The texture uvs of each particle
+    */
+    void CreateParticles(const std::vector<D3DXVECTOR3>& positions,
+        const std::vector<D3DXVECTOR2>& uvs);
+
+    /**
+    * Prepares the springs and solvers once all springs are added
+    */
+    void InitialiseSolvers();
+
+    /**
+    * Prepares the implicit and projective solvers from the 
+    * springs and a spring across each bending constraint
+    */
+    void InitialiseLinearSolvers();
+
+    /**
+    * Creates the directX mesh from the vertex and index data
+    */
+    void CreateMesh();
+
+    /**
+    * Orders the particles so those connected are close in memory
+    * @param neighbours The particles connected to each particle
+    * @return the original index of the particle for each new index
+    */
+    static std::vector<int> OrderParticles(const std::vector<std::vector<int>>& neighbours);
+
+    /**
+    * @return the rows of a square grid equivalent to the cloth
+    */
+    int GetSolverRows() const;
+
+    /**
+    * @return whether the cloth can currently tear
+    */
+    bool CanTear() const;
+
+    /**
+    * Tears the springs stretched beyond their limit by splitting 
+    * their particles and updating only the affected springs and triangles
+    */
+    void TearCloth();
+
+    /**
+    * Splits a particle in two along the plane facing the other particle 
+    * of a torn spring, moving the triangles and springs on that side
+    * @param index The index of the particle to split
+    * @param other The index of the other particle of the torn spring
+    * @param changedTriangles Filled with the index of each triangle changed
+    * @return whether the particle had triangles on both sides to split
+    */
+    bool SplitParticle(int index, int other, std::vector<int>& changedTriangles);
+
+    /**
+    * Adds a particle copying the state of another particle
+    * @param source The index of the particle to copy
+    * @return the index of the new particle
+    */
+    int AddParticle(int source);
+
+    /**
+    * Copies the changed triangles to the directX index buffer
+    * @param triangles The index of each triangle to copy
+    */
+    void UpdateIndexBuffer(const std::vector<int>& triangles);
 
     /**
     * Smooths the cloth vertices
@@ -208,8 +424,14 @@ private:
 
     /**
     * Updates all generic vertices of the cloth
+    * @param interpolation The amount between the previous and current physics step
     */
-    void UpdateVertices();
+    void UpdateVertices(float interpolation);
+
+    /**
+    * Interpolates the rendered vertices from the simulated vertices if coarser
+    */
+    void UpdateDetailVertices();
 
     /**
     * Updates the extra vertices if subdivision is required
@@ -238,7 +460,7 @@ private:
     * @param row/column The row and column of the required particle
     * @return the particle in grid at row/col
     */
-    ParticlePtr& GetParticle(int row, int column);
+    Particle GetParticle(int row, int column);
 
     /**
     * Creates a normal from the given three particles
@@ -249,16 +471,33 @@ private:
         const D3DXVECTOR3& p2, const D3DXVECTOR3& p3);
     
     /**
-    * Adds a force to the given particle
-    * @param particle Particle to add the force to
-    * @param force The force to add
+    * @param particle The particle to set the color for
     */
-    void AddForce(const ParticlePtr& particle, const D3DXVECTOR3& force);
+    void SetParticleColor(Particle& particle);
 
     /**
-    * @param particle The particle to set the color for
+    * @return the most iterations the springs can be relaxed for each tick
+    */
+    int GetIterationLimit() const;
+
+    /**
+    * @return whether the current solver relaxes the springs by position
+    * and so can skip the regions of the cloth at rest
+    */
+    bool IsPositionBased() const;
+
+    /**
+    * Relaxes the springs towards their rest distance
+    * then moves the particles with verlet integration
+    * @note iterations become V-cycles for the multigrid solver
+    */
+    void SolvePositionBased();
+
+    /**
+    * Moves the particles and solves the springs as compliant 
+    * constraints over substeps, with one iteration for each substep
     */
-    void SetParticleColor(const ParticlePtr& particle);
+    void SolveExtendedPositionBased();
 
     /**
     * Prevent copying
@@ -273,6 +512,9 @@ private:
     int m_springCount;          ///< Number of springs in cloth
     int m_springIterations;     ///< Number of solver iterations per tick
     int m_particleLength;       ///< Number of particles in a row/column
+    int m_detailLength;         ///< Number of rendered vertices in a row/column of the grid
+    int m_simulationLevel;      ///< Times the simulated rows are halved from the rendered rows
+    int m_fixedLevel;           ///< Simulation level chosen for the cloth or NO_INDEX to follow the camera
     int m_particleCount;        ///< Overall number of particles in the cloth
     int m_quadVertices;         ///< Number of vertices that center each quad
     bool m_simulation;          ///< Whether the cloth is currently simulating
@@ -282,15 +524,45 @@ private:
     bool m_handleMode;          ///< Whether the simulation is in handle mode
     bool m_subdivideCloth;      ///< Whether to subdivide the cloth or not
     D3DXVECTOR3 m_gravity;      ///< Simulated Gravity of the cloth
+    D3DXVECTOR3 m_offset;       ///< Amount moved from the starting position
     float m_generalSmoothing;   ///< General overall smoothing of the cloth
     int m_diagnosticParticle;   ///< Particle for rendering diagnostics
+    Solver m_solver;            ///< Method used for solving the springs
+    bool m_adaptiveIterations;  ///< Whether to relax the springs until within tolerance
+    int m_iterationsUsed;       ///< Number of iterations the springs were relaxed last tick
+    float m_maxStretchError;    ///< Largest relative spring error after relaxing last tick
+    float m_rmsStretchError;    ///< Root mean square relative spring error after relaxing last tick
+    bool m_tearing;             ///< Whether springs stretched too far tear the cloth
+    bool m_torn;                ///< Whether the cloth has torn since it was created
+    bool m_attach;              ///< Whether particles are tethered to their closest pinned particle
+    bool m_rebuildAttachments;  ///< Whether the pinned particles or springs changed since tethering
+    bool m_blowing;             ///< Whether the wind blows on the cloth
 
     EnginePtr m_engine;                           ///< Callbacks for the rendering engine
     std::vector<D3DXVECTOR3> m_colors;            ///< Viable colors for the particles
-    std::vector<SpringPtr> m_springs;             ///< Springs connecting particles together
-    std::vector<ParticlePtr> m_particles;         ///< Particles across the cloth grid
+    SpringBuffer m_springs;                       ///< Springs connecting particles together
+    SpringBuffer m_linearSprings;                 ///< Springs with bending for the implicit and projective solvers
+    ParticleData m_particles;                     ///< Particles across the cloth grid
+    std::vector<D3DXVECTOR3> m_previousState;     ///< Particle positions before the last physics step
+    std::unique_ptr<ImplicitSolver> m_implicit;   ///< Solver for implicit integration
+    std::unique_ptr<ProjectiveSolver> m_projective; ///< Solver for projective dynamics
+    std::unique_ptr<HierarchicalSolver> m_hierarchy; ///< Solver for coarser grids of the cloth
+    std::unique_ptr<ChebyshevAccelerator> m_chebyshev; ///< Acceleration of the spring relaxation
+    std::unique_ptr<SleepTracker> m_sleep;        ///< Regions of the cloth at rest
+    std::unique_ptr<LongRangeAttachments> m_attachments; ///< Tethers to the pinned particles
+    std::unique_ptr<BendingConstraints> m_bending; ///< Angle constraints between neighbouring triangles
+    std::unique_ptr<WindField> m_wind;            ///< Wind pushing on the triangles of the cloth
     std::vector<MeshVertex> m_vertexData;         ///< DirectX Vertex data
+    std::vector<MeshVertex> m_detailData;         ///< Rendered vertices interpolated from a coarser grid
+    std::vector<std::pair<int, D3DXVECTOR3>> m_hiddenPins; ///< Pins between coarser particles and their offset from its surface
+    std::vector<int> m_heldPins;                  ///< Rendered vertices of particles pinned to hold the hidden pins
     std::vector<DWORD> m_indexData;               ///< DirectX Index data
+    std::vector<int> m_triangles;                 ///< Particle indices of each triangle of the cloth
+    std::vector<D3DXVECTOR3> m_meshPositions;     ///< Loaded mesh positions with an average edge of one
+    std::vector<D3DXVECTOR2> m_meshUvs;           ///< Loaded mesh texture uvs
+    std::vector<int> m_meshTriangles;             ///< Loaded mesh particle indices of each triangle
+    std::vector<std::vector<int>> m_particleTriangles; ///< Triangles using each particle
+    std::vector<int> m_overstretched;             ///< Springs stretched beyond their tear limit
     std::shared_ptr<CollisionMesh> m_template;    ///< Template collision for all particles
     LPD3DXMESH m_mesh;                            ///< Directx geometry mesh
     LPDIRECT3DTEXTURE9 m_texture;                 ///< The texture attached to the mesh
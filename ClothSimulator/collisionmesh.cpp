@@ -422,6 +422,11 @@ bool CollisionMesh::IsDynamic() const
     return false;
 }
 
+bool CollisionMesh::IsAsleep() const
+{
+    return false;
+}
+
 const D3DXVECTOR3& CollisionMesh::GetVelocity() const
 {
     return m_velocity;
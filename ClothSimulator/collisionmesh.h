@@ -230,6 +230,11 @@ public:
     */
     virtual bool IsDynamic() const;
 
+    /**
+    * @return whether the owner of the collision mesh is at rest
+    */
+    virtual bool IsAsleep() const;
+
 protected:
 
     /**
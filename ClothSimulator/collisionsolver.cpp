@@ -6,11 +6,16 @@
 #include "particle.h"
 #include "cloth.h"
 #include "simplex.h"
+#include "spatialhash.h"
+#include "threadpool.h"
 #include <assert.h>
 
-CollisionSolver::CollisionSolver(std::shared_ptr<Engine> engine, 
-                                 std::shared_ptr<Cloth> cloth) :
-    m_cloth(cloth),
+namespace
+{
+    const float MIN_SEPARATION = 0.0001f; ///< Distance below which particles have no direction to separate in
+}
+
+CollisionSolver::CollisionSolver(std::shared_ptr<Engine> engine) :
     m_engine(engine)
 {
 }
@@ -19,6 +24,14 @@ CollisionSolver::~CollisionSolver()
 {
 }
 
+void CollisionSolver::AddCloth(std::shared_ptr<Cloth> cloth)
+{
+    ClothCollision collision;
+    collision.cloth = cloth;
+    collision.hash.reset(new SpatialHash());
+    m_cloths.push_back(std::move(collision));
+}
+
 void CollisionSolver::SolveParticleCollision(CollisionMesh& particleA, 
                                              CollisionMesh& particleB)
 {
@@ -26,7 +39,10 @@ void CollisionSolver::SolveParticleCollision(CollisionMesh& particleA,
     const float lengthSqr = D3DXVec3LengthSq(&particleToParticle);
     const float combinedRadius = particleA.GetRadius() + particleB.GetRadius();
 
-    if (lengthSqr < (combinedRadius*combinedRadius))
+    // Particles split from each other when tearing start on the same position
+    // and are left for their springs to separate rather than dividing by zero
+    if (lengthSqr < (combinedRadius*combinedRadius) &&
+        lengthSqr > (MIN_SEPARATION*MIN_SEPARATION))
     {
         const float length = std::sqrt(lengthSqr);
         particleToParticle /= std::sqrt(length);
@@ -293,21 +309,75 @@ void CollisionSolver::SolveClothCollision(const D3DXVECTOR3& minBounds,
 {
     D3DPERF_BeginEvent(D3DCOLOR(), L"CollisionSolver::SolveClothCollision");
 
-    assert(!m_cloth.expired());
-    auto cloth = m_cloth.lock();
+    // Each cloth only moves its own particles so they can be solved together
+    const int clothCount = static_cast<int>(m_cloths.size());
+    m_engine->threadpool()->ParallelFor(clothCount, 1, 
+        [this, &minBounds, &maxBounds](int begin, int end)
+        {
+            for(int i = begin; i < end; ++i)
+            {
+                SolveClothCollision(m_cloths[i], minBounds, maxBounds);
+            }
+        });
+
+    // Particles of both cloths are moved so pairs are solved one at a time
+    for(int i = 0; i < clothCount; ++i)
+    {
+        for(int j = i + 1; j < clothCount; ++j)
+        {
+            assert(!m_cloths[i].cloth.expired() && !m_cloths[j].cloth.expired());
+            const bool smaller = m_cloths[i].cloth.lock()->GetSpacing() <= 
+                m_cloths[j].cloth.lock()->GetSpacing();
+
+            SolveClothPairCollision(m_cloths[smaller ? i : j], m_cloths[smaller ? j : i]);
+        }
+    }
+
+    D3DPERF_EndEvent();
+}
+
+void CollisionSolver::SolveClothCollision(ClothCollision& collision,
+                                          const D3DXVECTOR3& minBounds, 
+                                          const D3DXVECTOR3& maxBounds)
+{
+    assert(!collision.cloth.expired());
+    auto cloth = collision.cloth.lock();
     auto& particles = cloth->GetParticles();
+    auto& neighbours = collision.neighbours;
 
-    for(unsigned int i = 0; i < particles.size(); ++i)
+    // Nothing has moved so nothing new can collide
+    if(cloth->IsAsleep())
     {
-        // Solve the particles against themselves
-        for(unsigned int j = i+1; j < particles.size(); ++j)
+        return;
+    }
+
+    // Particles can only collide when closer than their combined radius which
+    // is the cloth spacing; hash on this so only neighbouring cells are tested
+    const int particleCount = static_cast<int>(particles.positions.size());
+    collision.hash->Build(particles.positions, static_cast<float>(cloth->GetSpacing()));
+
+    for(int i = 0; i < particleCount; ++i)
+    {
+        // Sleeping particles have not moved so are only found by awake particles
+        if(particles.flags[i] & ParticleData::SLEEPING)
         {
-            SolveParticleCollision(particles[i]->GetCollisionMesh(), 
-                particles[j]->GetCollisionMesh());
+            continue;
+        }
+
+        // Solve the particles against themselves; awake pairs are found from both
+        // particles so are only solved once while sleeping ones are never searched from
+        collision.hash->FindNeighbours(particles.positions[i], neighbours);
+        for(int j : neighbours)
+        {
+            if(j > i || (particles.flags[j] & ParticleData::SLEEPING))
+            {
+                SolveParticleCollision(*particles.collisions[i], 
+                    *particles.collisions[j]);
+            }
         }
 
         // Solve the particle against the eight scene walls
-        const D3DXVECTOR3& particlePosition = particles[i]->GetPosition();
+        const D3DXVECTOR3& particlePosition = particles.positions[i];
         D3DXVECTOR3 position(0.0, 0.0, 0.0);
 
         // Check for ground and roof collisions
@@ -340,16 +410,44 @@ void CollisionSolver::SolveClothCollision(const D3DXVECTOR3& minBounds,
             position.z = minBounds.z-particlePosition.z;
         }
 
-        particles[i]->MovePosition(position);
+        if(!IsZeroVector(position))
+        {
+            Particle(particles, i).MovePosition(position);
+        }
     }
+}
 
-    D3DPERF_EndEvent();
+void CollisionSolver::SolveClothPairCollision(ClothCollision& clothA, 
+                                              ClothCollision& clothB)
+{
+    auto& particlesA = clothA.cloth.lock()->GetParticles();
+    auto& particlesB = clothB.cloth.lock()->GetParticles();
+    auto& neighbours = clothA.neighbours;
+
+    // The hash for the cloth with the larger spacing has cells wide 
+    // enough to hold any particles within the combined radius
+    const int particleCount = static_cast<int>(particlesA.positions.size());
+    for(int i = 0; i < particleCount; ++i)
+    {
+        const bool asleep = (particlesA.flags[i] & ParticleData::SLEEPING) != 0;
+
+        clothB.hash->FindNeighbours(particlesA.positions[i], neighbours);
+        for(int j : neighbours)
+        {
+            if(!(asleep && (particlesB.flags[j] & ParticleData::SLEEPING)))
+            {
+                SolveParticleCollision(*particlesA.collisions[i], 
+                    *particlesB.collisions[j]);
+            }
+        }
+    }
 }
 
 void CollisionSolver::SolveObjectCollision(CollisionMesh& particle,
                                            const CollisionMesh& object)
 {
-    if(particle.IsDynamic())
+    // Resting particles only need testing against objects that are moving
+    if(particle.IsDynamic() && (!particle.IsAsleep() || !IsZeroVector(object.GetVelocity())))
     {
         if(object.GetShape() == Geometry::SPHERE)
         {
@@ -10,6 +10,7 @@ struct Face;
 class Simplex;
 class Particle;
 class Cloth;
+class SpatialHash;
 
 /**
 * Detects and solves cloth-object and cloth-cloth collisions
@@ -21,15 +22,20 @@ public:
     /**
     * Constructor
     * @param engine Callbacks from the rendering engine
-    * @param cloth The cloth to solve collisions for
     */
-    CollisionSolver(std::shared_ptr<Engine> engine, std::shared_ptr<Cloth> cloth);
+    explicit CollisionSolver(std::shared_ptr<Engine> engine);
 
     /**
     * Destructor
     */
     ~CollisionSolver();
 
+    /**
+    * Adds a cloth to solve collisions for
+    * @param cloth The cloth to add
+    */
+    void AddCloth(std::shared_ptr<Cloth> cloth);
+
     /**
     * Detects and solves cloth particle-particle and particle-wall collisions
     * @param minBounds The minimum point inside the walls
@@ -46,12 +52,38 @@ public:
 
 private:
 
+    /**
+    * Cloth and the broadphase used for its particles
+    */
+    struct ClothCollision
+    {
+        std::weak_ptr<Cloth> cloth;          ///< Cloth object holding the particles
+        std::unique_ptr<SpatialHash> hash;   ///< Broadphase for the cloth particles
+        std::vector<int> neighbours;         ///< Cached particles found by the broadphase
+    };
+
     /**
     * Prevent copying
     */
     CollisionSolver(const CollisionSolver&) = delete;
     CollisionSolver& operator=(const CollisionSolver&) = delete;
 
+    /**
+    * Detects and solves particle-particle and particle-wall collisions for one cloth
+    * @param collision The cloth to solve
+    * @param minBounds The minimum point inside the walls
+    * @param maxBounds The maximum point inside the walls
+    */
+    void SolveClothCollision(ClothCollision& collision, 
+        const D3DXVECTOR3& minBounds, const D3DXVECTOR3& maxBounds);
+
+    /**
+    * Detects and solves collisions between the particles of two cloths
+    * @param clothA The first cloth which must have the smaller spacing
+    * @param clothB The second cloth whose broadphase is searched
+    */
+    void SolveClothPairCollision(ClothCollision& clothA, ClothCollision& clothB);
+
     /**
     * Detects and solves a collision between two particles
     * @param particleA The collision mesh for the first particle
@@ -143,6 +175,6 @@ private:
     */
     void UpdateDiagnostics(const Simplex& simplex, const D3DXVECTOR3& furthestPoint);
 
-    std::weak_ptr<Cloth> m_cloth;     ///< Cloth object holding all particles
-    std::shared_ptr<Engine> m_engine; ///< Callbacks for the rendering engine
+    std::vector<ClothCollision> m_cloths;  ///< Cloths to solve collisions for
+    std::shared_ptr<Engine> m_engine;      ///< Callbacks for the rendering engine
 };
\ No newline at end of file
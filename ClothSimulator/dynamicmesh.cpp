@@ -27,7 +27,8 @@ DynamicMesh::DynamicMesh(EnginePtr engine, DynamicMesh::MotionFn resolveFn) :
     m_resolveVelocity(0.0f, 0.0f, 0.0f),
     m_resolveFn(resolveFn),
     m_collisionType(NO_COLLISION),
-    m_cachedCollisionType(NO_COLLISION)
+    m_cachedCollisionType(NO_COLLISION),
+    m_asleep(false)
 {
     SetDraw(true);
 }
@@ -145,6 +146,16 @@ bool DynamicMesh::IsDynamic() const
     return m_resolveFn != nullptr;
 }
 
+bool DynamicMesh::IsAsleep() const
+{
+    return m_asleep;
+}
+
+void DynamicMesh::SetAsleep(bool asleep)
+{
+    m_asleep = asleep;
+}
+
 bool DynamicMesh::IsCollidingWith(Geometry::Shape shape) const
 {
     unsigned int collisionType = GetCollisionType(shape);
@@ -79,6 +79,16 @@ public:
     */
     virtual bool IsDynamic() const override;
 
+    /**
+    * @return whether the owner of the collision mesh is at rest
+    */
+    virtual bool IsAsleep() const override;
+
+    /**
+    * @param asleep Set whether the owner of the collision mesh is at rest
+    */
+    void SetAsleep(bool asleep);
+
     /**
     * @param shape The shape to query for interaction
     * @return whether the mesh is colliding with the given shape
@@ -109,4 +119,5 @@ private:
     MotionFn m_resolveFn;                      ///< Translate the collision in response to a collision
     unsigned int m_collisionType;              ///< Interacting collision bodies this tick
     unsigned int m_cachedCollisionType;        ///< Interacting collision bodies last tick 
+    bool m_asleep;                             ///< Whether the owner is at rest
 };                                             
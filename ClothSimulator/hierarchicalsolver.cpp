@@ -0,0 +1,224 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - hierarchicalsolver.cpp
+////////////////////////////////////////////////////////////////////////////////////////
+
+#include "hierarchicalsolver.h"
+#include "threadpool.h"
+
+namespace
+{
+    const int MIN_ROWS = 4;           ///< Grids with this many rows or less are not coarsened
+    const int COARSE_ITERATIONS = 4;  ///< Relaxations of the coarsest grid each cycle
+    const int ROW_GRAIN = 16;         ///< Minimum rows given to a single thread
+}
+
+HierarchicalSolver::HierarchicalSolver()
+{
+}
+
+HierarchicalSolver::~HierarchicalSolver()
+{
+}
+
+int HierarchicalSolver::GetLevelCount() const
+{
+    return static_cast<int>(m_levels.size()) + 1;
+}
+
+void HierarchicalSolver::Initialise(const ParticleData& particles, int rows)
+{
+    m_levels.clear();
+
+    const ParticleData* fine = &particles;
+    int fineRows = rows;
+
+    while(fineRows > MIN_ROWS)
+    {
+        std::unique_ptr<Level> level(new Level());
+        level->fineRows = fineRows;
+        level->rows = (fineRows / 2) + 1;
+
+        // Coarse rows sit on every second fine row with the
+        // last coarse row always on the last fine row
+        auto getFineRow = [fineRows](int row) { return min(row * 2, fineRows - 1); };
+
+        level->lowerRow.resize(fineRows);
+        level->upperRow.resize(fineRows);
+        level->rowWeight.resize(fineRows);
+        for(int row = 0; row < fineRows; ++row)
+        {
+            const int lower = row / 2;
+            level->lowerRow[row] = lower;
+            if(getFineRow(lower) == row)
+            {
+                level->upperRow[row] = lower;
+                level->rowWeight[row] = 0.0f;
+            }
+            else
+            {
+                level->upperRow[row] = lower + 1;
+                level->rowWeight[row] = static_cast<float>(row - getFineRow(lower)) / 
+                    static_cast<float>(getFineRow(lower + 1) - getFineRow(lower));
+            }
+        }
+
+        const int count = level->rows * level->rows;
+        level->particles.Resize(count);
+        level->fineParticles.resize(count);
+        level->restricted.resize(count);
+        for(int x = 0; x < level->rows; ++x)
+        {
+            for(int y = 0; y < level->rows; ++y)
+            {
+                const int index = (x * level->rows) + y;
+                const int fineIndex = (getFineRow(x) * fineRows) + getFineRow(y);
+                level->fineParticles[index] = fineIndex;
+            }
+        }
+        Restrict(*fine, *level);
+
+        // Coarse springs hold the rest distance between the fine particles they
+        // span; bending is left to the finest grid as it does not carry far
+        auto createSpring = [&level](int x1, int y1, int x2, int y2, Spring::Type type)
+        {
+            level->springs.AddSpring(level->particles, 
+                (x1 * level->rows) + y1, (x2 * level->rows) + y2, type);
+        };
+
+        level->springs.Clear(count * 4);
+        for(int x = 0; x < level->rows; ++x)
+        {
+            for(int y = 0; y < level->rows; ++y)
+            {
+                if(x+1 < level->rows)
+                {
+                    createSpring(x, y, x+1, y, Spring::STRETCH);
+                }
+                if(y+1 < level->rows)
+                {
+                    createSpring(x, y, x, y+1, Spring::STRETCH);
+                }
+                if(x+1 < level->rows && y+1 < level->rows)
+                {
+                    createSpring(x, y, x+1, y+1, Spring::SHEAR);
+                    createSpring(x+1, y, x, y+1, Spring::SHEAR);
+                }
+            }
+        }
+        level->springs.SortSprings(count);
+
+        fine = &level->particles;
+        fineRows = level->rows;
+        m_levels.push_back(std::move(level));
+    }
+}
+
+void HierarchicalSolver::Solve(ParticleData& particles, 
+                               const SpringBuffer& springs, 
+                               ThreadPool& pool)
+{
+    Cycle(0, particles, springs, pool);
+}
+
+void HierarchicalSolver::Cycle(int level, 
+                               ParticleData& particles, 
+                               const SpringBuffer& springs, 
+                               ThreadPool& pool)
+{
+    if(level < static_cast<int>(m_levels.size()))
+    {
+        Level& coarse = *m_levels[level];
+        Restrict(particles, coarse);
+        Cycle(level + 1, coarse.particles, coarse.springs, pool);
+        Prolongate(coarse, particles, pool);
+    }
+
+    if(level == 0)
+    {
+        springs.SolveSprings(particles, pool);
+    }
+    else
+    {
+        // Coarse springs span several fine springs which can fold freely, 
+        // so they only stop the cloth stretching and never push it apart
+        const int iterations = level == static_cast<int>(m_levels.size()) ? COARSE_ITERATIONS : 1;
+        for(int i = 0; i < iterations; ++i)
+        {
+            springs.SolveStretching(particles, pool);
+        }
+    }
+}
+
+void HierarchicalSolver::Restrict(const ParticleData& fine, Level& coarse)
+{
+    for(unsigned int i = 0; i < coarse.fineParticles.size(); ++i)
+    {
+        // Masses can change after the hierarchy is built so follow the fine grid
+        coarse.particles.positions[i] = fine.positions[coarse.fineParticles[i]];
+        coarse.particles.masses[i] = fine.masses[coarse.fineParticles[i]];
+        coarse.restricted[i] = coarse.particles.positions[i];
+        coarse.particles.SetFlag(i, ParticleData::PINNED, false);
+    }
+
+    // Pin any coarse particle a pinned or sleeping fine particle is
+    // interpolated from so the coarse grid cannot drag it away
+    for(int x = 0; x < coarse.fineRows; ++x)
+    {
+        for(int y = 0; y < coarse.fineRows; ++y)
+        {
+            if(fine.flags[(x * coarse.fineRows) + y] & ParticleData::STATIC)
+            {
+                const int rowsX[] = { coarse.lowerRow[x], coarse.upperRow[x] };
+                const int rowsY[] = { coarse.lowerRow[y], coarse.upperRow[y] };
+                for(int i = 0; i < 2; ++i)
+                {
+                    for(int j = 0; j < 2; ++j)
+                    {
+                        coarse.particles.SetFlag((rowsX[i] * coarse.rows) + 
+                            rowsY[j], ParticleData::PINNED, true);
+                    }
+                }
+            }
+        }
+    }
+}
+
+void HierarchicalSolver::Prolongate(Level& coarse, ParticleData& fine, ThreadPool& pool)
+{
+    // Only the change made by the coarse grid is passed back up
+    for(unsigned int i = 0; i < coarse.restricted.size(); ++i)
+    {
+        coarse.restricted[i] = coarse.particles.positions[i] - coarse.restricted[i];
+    }
+
+    pool.ParallelFor(coarse.fineRows, ROW_GRAIN, [&coarse, &fine](int begin, int end)
+    {
+        const std::vector<D3DXVECTOR3>& deltas = coarse.restricted;
+        for(int x = begin; x < end; ++x)
+        {
+            const int lowerX = coarse.lowerRow[x] * coarse.rows;
+            const int upperX = coarse.upperRow[x] * coarse.rows;
+            const float weightX = coarse.rowWeight[x];
+
+            for(int y = 0; y < coarse.fineRows; ++y)
+            {
+                const int index = (x * coarse.fineRows) + y;
+                if(fine.flags[index] & ParticleData::STATIC)
+                {
+                    continue;
+                }
+
+                const int lowerY = coarse.lowerRow[y];
+                const int upperY = coarse.upperRow[y];
+                const float weightY = coarse.rowWeight[y];
+
+                const D3DXVECTOR3 lower(deltas[lowerX + lowerY] * (1.0f - weightY) + 
+                    deltas[lowerX + upperY] * weightY);
+                const D3DXVECTOR3 upper(deltas[upperX + lowerY] * (1.0f - weightY) + 
+                    deltas[upperX + upperY] * weightY);
+
+                fine.positions[index] += lower * (1.0f - weightX) + upper * weightX;
+            }
+        }
+    });
+}
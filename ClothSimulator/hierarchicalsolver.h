@@ -0,0 +1,105 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - hierarchicalsolver.h
+////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include "common.h"
+#include "particle.h"
+#include "spring.h"
+
+class ThreadPool;
+
+/**
+* Multigrid solver for the cloth springs. Relaxing springs only moves a
+* correction one particle further each iteration, so coarser grids made from
+* every second row and column of the cloth are solved in between. Each V-cycle
+* restricts the positions to the next coarser grid, solves there and prolongates
+* the change back before relaxing the grid. Cycles run back to back each iteration
+* so the relaxation ending one cycle smooths the grid before the next restricts it.
+*/
+class HierarchicalSolver
+{
+public:
+
+    /**
+    * Constructor
+    */
+    HierarchicalSolver();
+
+    /**
+    * Destructor
+    */
+    ~HierarchicalSolver();
+
+    /**
+    * Builds the coarser grids from the cloth at rest
+    * @param particles The particle data of the cloth grid
+    * @param rows The number of particles in a row/column or 
+    *        zero where the cloth is not a grid and only it is solved
+    */
+    void Initialise(const ParticleData& particles, int rows);
+
+    /**
+    * Runs a single V-cycle moving the particles towards the spring rest distances
+    * @param particles The particle data of the cloth grid
+    * @param springs The springs connecting the particles
+    * @param pool The threads to solve with
+    */
+    void Solve(ParticleData& particles, const SpringBuffer& springs, ThreadPool& pool);
+
+    /**
+    * @return the number of grids solved including the cloth
+    */
+    int GetLevelCount() const;
+
+private:
+
+    /**
+    * Coarser grid made from every second row/column of the grid above
+    */
+    struct Level
+    {
+        int rows;                              ///< Number of particles in a row/column
+        int fineRows;                          ///< Number of particles in a row/column of the finer grid
+        ParticleData particles;                ///< Particles of the coarse grid
+        SpringBuffer springs;                  ///< Springs connecting the coarse particles
+        std::vector<int> fineParticles;        ///< Particle of the finer grid for each coarse particle
+        std::vector<int> lowerRow;             ///< Coarse row before each row of the finer grid
+        std::vector<int> upperRow;             ///< Coarse row after each row of the finer grid
+        std::vector<float> rowWeight;          ///< Weighting towards the upper row for each row of the finer grid
+        std::vector<D3DXVECTOR3> restricted;   ///< Coarse positions before solving the coarse grid
+    };
+
+    /**
+    * Solves all coarser grids and then relaxes the grid at the level
+    * @param level The index of the coarse level below the grid
+    * @param particles The particle data of the grid
+    * @param springs The springs connecting the particles
+    * @param pool The threads to solve with
+    */
+    void Cycle(int level, ParticleData& particles, 
+        const SpringBuffer& springs, ThreadPool& pool);
+
+    /**
+    * Copies the positions of the finer grid to the coarse grid
+    * @param fine The particle data of the finer grid
+    * @param coarse The coarse level to fill
+    */
+    void Restrict(const ParticleData& fine, Level& coarse);
+
+    /**
+    * Interpolates the movement of the coarse grid onto the finer grid
+    * @param coarse The solved coarse level
+    * @param fine The particle data of the finer grid
+    * @param pool The threads to solve with
+    */
+    void Prolongate(Level& coarse, ParticleData& fine, ThreadPool& pool);
+
+    /**
+    * Prevent copying
+    */
+    HierarchicalSolver(const HierarchicalSolver&);
+    HierarchicalSolver& operator=(const HierarchicalSolver&);
+
+    std::vector<std::unique_ptr<Level>> m_levels; ///< Coarse grids from finest to coarsest
+};
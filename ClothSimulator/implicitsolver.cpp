@@ -0,0 +1,312 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - implicitsolver.cpp
+////////////////////////////////////////////////////////////////////////////////////////
+
+#include "implicitsolver.h"
+#include "particle.h"
+#include "threadpool.h"
+#include <algorithm>
+
+namespace
+{
+    const int MAX_ITERATIONS = 30;       ///< Maximum conjugate gradient iterations
+    const float TOLERANCE = 1.0e-6f;     ///< Squared residual relative to the start to stop at
+    const int ROW_GRAIN = 256;           ///< Minimum rows given to a single thread
+
+    /**
+    * Multiplies a row major 3x3 block with a vector
+    */
+    inline D3DXVECTOR3 MultiplyBlock(const std::array<float, 9>& block, const D3DXVECTOR3& vector)
+    {
+        return D3DXVECTOR3(
+            block[0]*vector.x + block[1]*vector.y + block[2]*vector.z,
+            block[3]*vector.x + block[4]*vector.y + block[5]*vector.z,
+            block[6]*vector.x + block[7]*vector.y + block[8]*vector.z);
+    }
+}
+
+ImplicitSolver::ImplicitSolver() :
+    m_iterations(0)
+{
+    std::fill(m_stiffness, m_stiffness + Spring::MAX_TYPES, 1.0f);
+}
+
+void ImplicitSolver::SetStiffness(Spring::Type type, float stiffness)
+{
+    m_stiffness[type] = stiffness;
+}
+
+int ImplicitSolver::GetIterations() const
+{
+    return m_iterations;
+}
+
+void ImplicitSolver::Initialise(const SpringBuffer& springs, int particleCount)
+{
+    // Each row holds the diagonal block followed by a block 
+    // for every particle connected to it through a spring
+    std::vector<std::vector<int>> neighbours(particleCount);
+    for(int i = 0; i < springs.GetCount(); ++i)
+    {
+        const Spring& spring = springs.GetSpring(i);
+        neighbours[spring.particle1].push_back(spring.particle2);
+        neighbours[spring.particle2].push_back(spring.particle1);
+    }
+
+    m_rowStart.assign(particleCount + 1, 0);
+    m_columns.clear();
+    for(int i = 0; i < particleCount; ++i)
+    {
+        std::vector<int>& row = neighbours[i];
+        std::sort(row.begin(), row.end());
+        row.erase(std::unique(row.begin(), row.end()), row.end());
+
+        m_columns.push_back(i);
+        m_columns.insert(m_columns.end(), row.begin(), row.end());
+        m_rowStart[i+1] = static_cast<int>(m_columns.size());
+    }
+    m_blocks.resize(m_columns.size());
+
+    auto findBlock = [this](int row, int column) -> int
+    {
+        const auto begin = m_columns.begin() + m_rowStart[row];
+        const auto end = m_columns.begin() + m_rowStart[row+1];
+        return static_cast<int>(std::find(begin, end, column) - m_columns.begin());
+    };
+
+    m_springBlocks.resize(springs.GetCount());
+    for(int i = 0; i < springs.GetCount(); ++i)
+    {
+        const Spring& spring = springs.GetSpring(i);
+        m_springBlocks[i].block11 = m_rowStart[spring.particle1];
+        m_springBlocks[i].block22 = m_rowStart[spring.particle2];
+        m_springBlocks[i].block12 = findBlock(spring.particle1, spring.particle2);
+        m_springBlocks[i].block21 = findBlock(spring.particle2, spring.particle1);
+    }
+
+    m_free.resize(particleCount);
+    m_velocities.resize(particleCount);
+    m_rhs.resize(particleCount);
+    m_deltas.resize(particleCount);
+    m_residual.resize(particleCount);
+    m_direction.resize(particleCount);
+    m_product.resize(particleCount);
+    m_preconditioned.resize(particleCount);
+    m_preconditioner.resize(particleCount);
+}
+
+void ImplicitSolver::Solve(ParticleData& particles, 
+                           const SpringBuffer& springs,
+                           ThreadPool& pool, 
+                           float damping, 
+                           float timestepSqr)
+{
+    const int count = static_cast<int>(m_velocities.size());
+    for(int i = 0; i < count; ++i)
+    {
+        m_free[i] = !(particles.flags[i] & (ParticleData::PINNED|ParticleData::COLLIDING));
+        if(m_free[i])
+        {
+            m_velocities[i] = (particles.positions[i]-particles.previousPositions[i])*damping;
+        }
+        else
+        {
+            MakeZeroVector(m_velocities[i]);
+        }
+    }
+
+    Assemble(particles, springs, timestepSqr);
+    SolveConjugateGradient(pool);
+
+    for(int i = 0; i < count; ++i)
+    {
+        particles.previousPositions[i] = particles.positions[i];
+        if(m_free[i])
+        {
+            particles.positions[i] += m_velocities[i] + m_deltas[i];
+        }
+        MakeZeroVector(particles.accelerations[i]);
+    }
+}
+
+void ImplicitSolver::Assemble(const ParticleData& particles, 
+                              const SpringBuffer& springs, 
+                              float timestepSqr)
+{
+    // The tick is used as the unit of time so h = 1
+    const int count = static_cast<int>(m_velocities.size());
+    for(int i = 0; i < count; ++i)
+    {
+        const float mass = particles.masses[i];
+        m_rhs[i] = particles.accelerations[i] * (mass * timestepSqr);
+
+        for(int j = m_rowStart[i]; j < m_rowStart[i+1]; ++j)
+        {
+            m_blocks[j].fill(0.0f);
+        }
+
+        Block& diagonal = m_blocks[m_rowStart[i]];
+        diagonal[0] = mass;
+        diagonal[4] = mass;
+        diagonal[8] = mass;
+    }
+
+    for(int i = 0; i < springs.GetCount(); ++i)
+    {
+        const Spring& spring = springs.GetSpring(i);
+        const unsigned int p1 = spring.particle1;
+        const unsigned int p2 = spring.particle2;
+
+        D3DXVECTOR3 difference(particles.positions[p2] - particles.positions[p1]);
+        const float length = D3DXVec3Length(&difference);
+        if(length == 0.0f)
+        {
+            continue;
+        }
+
+        const D3DXVECTOR3 normal(difference / length);
+        const float stiffness = m_stiffness[springs.GetType(i)];
+        const D3DXVECTOR3 force(normal * (stiffness * (length - spring.restDistance)));
+        m_rhs[p1] += force;
+        m_rhs[p2] -= force;
+
+        // Force jacobian K = k(nn' + (1 - L/l)(I - nn')), clamping the
+        // transverse term when compressed to keep the system definite
+        const float transverse = max(1.0f - (spring.restDistance / length), 0.0f);
+        const float n[3] = { normal.x, normal.y, normal.z };
+        Block jacobian;
+        for(int r = 0; r < 3; ++r)
+        {
+            for(int c = 0; c < 3; ++c)
+            {
+                const float outer = n[r] * n[c];
+                const float identity = r == c ? 1.0f : 0.0f;
+                jacobian[r*3+c] = stiffness * (outer + transverse * (identity - outer));
+            }
+        }
+
+        // A = M - h^2 dF/dx where dF1/dx1 = -K and dF1/dx2 = K
+        const SpringBlocks& blocks = m_springBlocks[i];
+        for(int b = 0; b < 9; ++b)
+        {
+            m_blocks[blocks.block11][b] += jacobian[b];
+            m_blocks[blocks.block22][b] += jacobian[b];
+            m_blocks[blocks.block12][b] -= jacobian[b];
+            m_blocks[blocks.block21][b] -= jacobian[b];
+        }
+
+        // rhs = h(f + h K v)
+        const D3DXVECTOR3 velocityForce(MultiplyBlock(
+            jacobian, m_velocities[p2] - m_velocities[p1]));
+        m_rhs[p1] += velocityForce;
+        m_rhs[p2] -= velocityForce;
+    }
+
+    for(int i = 0; i < count; ++i)
+    {
+        const Block& diagonal = m_blocks[m_rowStart[i]];
+        m_preconditioner[i] = D3DXVECTOR3(1.0f / diagonal[0], 
+            1.0f / diagonal[4], 1.0f / diagonal[8]);
+    }
+}
+
+void ImplicitSolver::SolveConjugateGradient(ThreadPool& pool)
+{
+    const int count = static_cast<int>(m_velocities.size());
+    auto precondition = [this, count]()
+    {
+        for(int i = 0; i < count; ++i)
+        {
+            m_preconditioned[i].x = m_residual[i].x * m_preconditioner[i].x;
+            m_preconditioned[i].y = m_residual[i].y * m_preconditioner[i].y;
+            m_preconditioned[i].z = m_residual[i].z * m_preconditioner[i].z;
+        }
+    };
+
+    for(int i = 0; i < count; ++i)
+    {
+        MakeZeroVector(m_deltas[i]);
+    }
+
+    m_residual = m_rhs;
+    Filter(m_residual);
+    precondition();
+    m_direction = m_preconditioned;
+
+    float residualDot = Dot(m_residual, m_preconditioned);
+    const float target = Dot(m_residual, m_residual) * TOLERANCE;
+
+    for(m_iterations = 0; m_iterations < MAX_ITERATIONS; ++m_iterations)
+    {
+        if(Dot(m_residual, m_residual) <= target)
+        {
+            break;
+        }
+
+        Multiply(pool, m_direction, m_product);
+        Filter(m_product);
+
+        const float directionDot = Dot(m_direction, m_product);
+        if(directionDot <= 0.0f)
+        {
+            break;
+        }
+
+        const float alpha = residualDot / directionDot;
+        for(int i = 0; i < count; ++i)
+        {
+            m_deltas[i] += m_direction[i] * alpha;
+            m_residual[i] -= m_product[i] * alpha;
+        }
+
+        precondition();
+        const float previousDot = residualDot;
+        residualDot = Dot(m_residual, m_preconditioned);
+
+        const float beta = residualDot / previousDot;
+        for(int i = 0; i < count; ++i)
+        {
+            m_direction[i] = m_preconditioned[i] + (m_direction[i] * beta);
+        }
+    }
+}
+
+void ImplicitSolver::Multiply(ThreadPool& pool, 
+                              const std::vector<D3DXVECTOR3>& vector, 
+                              std::vector<D3DXVECTOR3>& result) const
+{
+    pool.ParallelFor(static_cast<int>(vector.size()), ROW_GRAIN, 
+        [this, &vector, &result](int begin, int end)
+        {
+            for(int i = begin; i < end; ++i)
+            {
+                D3DXVECTOR3 sum(0.0f, 0.0f, 0.0f);
+                for(int j = m_rowStart[i]; j < m_rowStart[i+1]; ++j)
+                {
+                    sum += MultiplyBlock(m_blocks[j], vector[m_columns[j]]);
+                }
+                result[i] = sum;
+            }
+        });
+}
+
+void ImplicitSolver::Filter(std::vector<D3DXVECTOR3>& vector) const
+{
+    for(unsigned int i = 0; i < vector.size(); ++i)
+    {
+        if(!m_free[i])
+        {
+            MakeZeroVector(vector[i]);
+        }
+    }
+}
+
+float ImplicitSolver::Dot(const std::vector<D3DXVECTOR3>& a, const std::vector<D3DXVECTOR3>& b)
+{
+    float dot = 0.0f;
+    for(unsigned int i = 0; i < a.size(); ++i)
+    {
+        dot += D3DXVec3Dot(&a[i], &b[i]);
+    }
+    return dot;
+}
@@ -0,0 +1,130 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - implicitsolver.h
+////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include "common.h"
+#include "spring.h"
+#include <array>
+
+struct ParticleData;
+class ThreadPool;
+
+/**
+* Backward euler integration of the cloth springs in the style of Baraff-Witkin.
+* Solves (M - h^2 K) dv = h (f + h K v) using a block sparse matrix with
+* a 3x3 block for every connected pair of particles and a jacobi
+* preconditioned conjugate gradient. The sparsity pattern is built 
+* once from the springs and reused each tick.
+*/
+class ImplicitSolver
+{
+public:
+
+    /**
+    * Constructor
+    */
+    ImplicitSolver();
+
+    /**
+    * Builds the sparsity pattern of the system from the springs
+    * @param springs The springs connecting the particles
+    * @param particleCount The number of particles the springs connect
+    */
+    void Initialise(const SpringBuffer& springs, int particleCount);
+
+    /**
+    * Moves the particles for a single tick
+    * @param particles The particle data to update
+    * @param springs The springs connecting the particles
+    * @param pool The threads to solve with
+    * @param damping The damping to apply to the movement
+    * @param timestepSqr Delta time squared
+    */
+    void Solve(ParticleData& particles, const SpringBuffer& springs,
+        ThreadPool& pool, float damping, float timestepSqr);
+
+    /**
+    * Sets the stiffness for all springs of a type
+    * @param type The type of spring to set
+    * @param stiffness How strongly the spring pulls towards its rest distance
+    */
+    void SetStiffness(Spring::Type type, float stiffness);
+
+    /**
+    * @return the number of conjugate gradient iterations run last tick
+    */
+    int GetIterations() const;
+
+private:
+
+    typedef std::array<float, 9> Block; ///< Row major 3x3 matrix
+
+    /**
+    * Indices of the blocks a spring contributes to
+    */
+    struct SpringBlocks
+    {
+        int block11;  ///< Diagonal block of the first particle
+        int block22;  ///< Diagonal block of the second particle
+        int block12;  ///< Block for the first row and second column
+        int block21;  ///< Block for the second row and first column
+    };
+
+    /**
+    * Fills the system matrix and right hand side for the current state
+    * @param particles The particle data to update
+    * @param springs The springs connecting the particles
+    * @param timestepSqr Delta time squared
+    */
+    void Assemble(const ParticleData& particles, 
+        const SpringBuffer& springs, float timestepSqr);
+
+    /**
+    * Solves the system for the change in velocity
+    * @param pool The threads to solve with
+    */
+    void SolveConjugateGradient(ThreadPool& pool);
+
+    /**
+    * Multiplies the system matrix with a vector
+    * @param pool The threads to solve with
+    * @param vector The vector to multiply
+    * @param result Filled with the result of the multiplication
+    */
+    void Multiply(ThreadPool& pool, const std::vector<D3DXVECTOR3>& vector, 
+        std::vector<D3DXVECTOR3>& result) const;
+
+    /**
+    * Removes any components for particles that are not free to move
+    * @param vector The vector to filter
+    */
+    void Filter(std::vector<D3DXVECTOR3>& vector) const;
+
+    /**
+    * @return the dot product of the two vectors
+    */
+    static float Dot(const std::vector<D3DXVECTOR3>& a, const std::vector<D3DXVECTOR3>& b);
+
+    /**
+    * Prevent copying
+    */
+    ImplicitSolver(const ImplicitSolver&);
+    ImplicitSolver& operator=(const ImplicitSolver&);
+
+    float m_stiffness[Spring::MAX_TYPES];    ///< Stiffness for each type of spring
+    int m_iterations;                        ///< Iterations run for the last solve
+    std::vector<int> m_rowStart;             ///< Offset of the first block for each row
+    std::vector<int> m_columns;              ///< Column of each block
+    std::vector<Block> m_blocks;             ///< Values of the system matrix
+    std::vector<SpringBlocks> m_springBlocks;///< Blocks each spring contributes to
+    std::vector<unsigned char> m_free;       ///< Whether each particle is free to move
+    std::vector<D3DXVECTOR3> m_velocities;   ///< Velocity of each particle at the start of the tick
+    std::vector<D3DXVECTOR3> m_rhs;          ///< Right hand side of the system
+    std::vector<D3DXVECTOR3> m_deltas;       ///< Solved change in velocity
+    std::vector<D3DXVECTOR3> m_residual;     ///< Conjugate gradient residual
+    std::vector<D3DXVECTOR3> m_direction;    ///< Conjugate gradient search direction
+    std::vector<D3DXVECTOR3> m_product;      ///< System matrix multiplied by the direction
+    std::vector<D3DXVECTOR3> m_preconditioned; ///< Residual multiplied by the preconditioner
+    std::vector<D3DXVECTOR3> m_preconditioner; ///< Inverse of the system matrix diagonal
+};
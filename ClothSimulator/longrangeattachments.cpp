@@ -0,0 +1,112 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - longrangeattachments.cpp
+////////////////////////////////////////////////////////////////////////////////////////
+
+#include "longrangeattachments.h"
+#include "particle.h"
+#include "spring.h"
+#include "threadpool.h"
+#include <queue>
+#include <functional>
+
+namespace
+{
+    const int ATTACHMENT_GRAIN = 1024;  ///< Minimum attachments given to a single thread
+}
+
+LongRangeAttachments::LongRangeAttachments()
+{
+}
+
+void LongRangeAttachments::Initialise(const ParticleData& particles, 
+                                      const SpringBuffer& springs)
+{
+    m_attachments.clear();
+
+    const int particleCount = static_cast<int>(particles.positions.size());
+    std::vector<float> distances(particleCount, FLT_MAX);
+    std::vector<int> anchors(particleCount, NO_INDEX);
+
+    // Search outwards from every pinned particle at once so each
+    // particle is reached first by the pin closest along the springs
+    typedef std::pair<float, int> Node;
+    std::priority_queue<Node, std::vector<Node>, std::greater<Node>> open;
+    for(int i = 0; i < particleCount; ++i)
+    {
+        if(particles.flags[i] & ParticleData::PINNED)
+        {
+            distances[i] = 0.0f;
+            anchors[i] = i;
+            open.push(Node(0.0f, i));
+        }
+    }
+
+    while(!open.empty())
+    {
+        const Node node = open.top();
+        open.pop();
+
+        const int particle = node.second;
+        if(node.first > distances[particle])
+        {
+            continue;
+        }
+
+        for(int index : springs.GetParticleSprings(particle))
+        {
+            const Spring& spring = springs.GetSpring(index);
+            const int neighbour = spring.particle1 == particle ? 
+                spring.particle2 : spring.particle1;
+
+            const float distance = node.first + spring.restDistance;
+            if(distance < distances[neighbour])
+            {
+                distances[neighbour] = distance;
+                anchors[neighbour] = anchors[particle];
+                open.push(Node(distance, neighbour));
+            }
+        }
+    }
+
+    for(int i = 0; i < particleCount; ++i)
+    {
+        if(anchors[i] != NO_INDEX && anchors[i] != i)
+        {
+            Attachment attachment = { i, anchors[i], distances[i] };
+            m_attachments.push_back(attachment);
+        }
+    }
+}
+
+void LongRangeAttachments::Solve(ParticleData& particles, ThreadPool& pool) const
+{
+    // Each particle has at most one attachment and pinned particles are only read
+    pool.ParallelFor(static_cast<int>(m_attachments.size()), ATTACHMENT_GRAIN,
+        [this, &particles](int begin, int end)
+        {
+            for(int i = begin; i < end; ++i)
+            {
+                const Attachment& attachment = m_attachments[i];
+                if(particles.flags[attachment.particle] & ParticleData::STATIC)
+                {
+                    continue;
+                }
+
+                const D3DXVECTOR3& anchor = particles.positions[attachment.anchor];
+                D3DXVECTOR3& position = particles.positions[attachment.particle];
+                const D3DXVECTOR3 difference(position - anchor);
+                const float distanceSqr = D3DXVec3LengthSq(&difference);
+
+                if(distanceSqr > attachment.maxDistance * attachment.maxDistance)
+                {
+                    position = anchor + difference * 
+                        (attachment.maxDistance / std::sqrt(distanceSqr));
+                }
+            }
+        });
+}
+
+int LongRangeAttachments::GetCount() const
+{
+    return static_cast<int>(m_attachments.size());
+}
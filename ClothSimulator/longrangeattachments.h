@@ -0,0 +1,65 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - longrangeattachments.h
+////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include "common.h"
+
+struct ParticleData;
+class SpringBuffer;
+class ThreadPool;
+
+/**
+* Long range attachments tethering each free particle to its closest pinned particle.
+* A particle is only pulled back when further from its pinned particle than the
+* shortest path between them along the springs, so the cloth cannot stretch away 
+* from the pins however few iterations are used but can still fold and compress.
+*/
+class LongRangeAttachments
+{
+public:
+
+    /**
+    * Constructor
+    */
+    LongRangeAttachments();
+
+    /**
+    * Finds the closest pinned particle for each particle along the springs
+    * @param particles The particle data holding which particles are pinned
+    * @param springs The springs connecting the particles
+    */
+    void Initialise(const ParticleData& particles, const SpringBuffer& springs);
+
+    /**
+    * Moves particles further than allowed from their pinned particle
+    * @param particles The particle data to constrain
+    * @param pool The threads to solve with
+    */
+    void Solve(ParticleData& particles, ThreadPool& pool) const;
+
+    /**
+    * @return the number of particles attached to a pinned particle
+    */
+    int GetCount() const;
+
+private:
+
+    /**
+    * Tether between a particle and a pinned particle
+    */
+    struct Attachment
+    {
+        int particle;        ///< Index of the particle constrained
+        int anchor;          ///< Index of the closest pinned particle
+        float maxDistance;   ///< Length of the shortest path between the particles
+    };
+
+    /**
+    * Prevent copying
+    */
+    LongRangeAttachments(const LongRangeAttachments&);
+    LongRangeAttachments& operator=(const LongRangeAttachments&);
+
+    std::vector<Attachment> m_attachments;  ///< Attachment for each particle that can reach a pin
+};
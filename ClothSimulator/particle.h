@@ -11,7 +11,139 @@ class Diagnostic;
 class Shader;
 
 /**
-* A sphere representing a vertex on the cloth
+* Contiguous state for all particles of a cloth
+* Hot data used every tick is kept apart from data only used for rendering
+*/
+struct ParticleData
+{
+    /**
+    * State flags for a particle
+    */
+    enum Flag
+    {
+        PINNED = 1,     ///< Whether particle is pinned
+        SELECTED = 2,   ///< Whether particle is selected
+        COLLIDING = 4,  ///< Whether particle collided last tick
+        SLEEPING = 8,   ///< Whether particle is in a region at rest
+        STATIC = PINNED|SLEEPING ///< Particle is not moved by the solver
+    };
+
+    /**
+    * Constructor
+    */
+    ParticleData();
+
+    /**
+    * Resizes the storage for all particles
+    * @param count The number of particles to hold
+    */
+    void Resize(int count);
+
+    /**
+    * Sets or clears a state flag of a particle. Pinned and sleeping particles
+    * have no inverse mass so the solvers can weight by it rather than check flags
+    * @param index The index of the particle
+    * @param flag The flag to change
+    * @param set Whether to set or clear the flag
+    */
+    void SetFlag(int index, Flag flag, bool set);
+
+    /**
+    * Sets the mass of a particle
+    * @param index The index of the particle
+    * @param mass The mass in kg of the particle
+    */
+    void SetMass(int index, float mass);
+
+    /**
+    * Adds a force to all particles scaled by their inverse mass
+    * @param force The force to add
+    */
+    void AddForce(const D3DXVECTOR3& force);
+
+    /**
+    * Adds an acceleration to all particles that are not static
+    * @param acceleration The acceleration to add regardless of mass
+    */
+    void AddAcceleration(const D3DXVECTOR3& acceleration);
+
+    /**
+    * Caches the velocity of any collisions resolved last tick for each particle
+    */
+    void UpdateInteractingVelocities();
+
+    /**
+    * Updates the positions of all particles that are free to move
+    * @param damping The damping to apply to the movement
+    * @param timestepSqr Delta time squared
+    */
+    void Integrate(float damping, float timestepSqr);
+
+    /**
+    * Derives the velocities of all particles before updating over substeps
+    */
+    void BeginSubsteps();
+
+    /**
+    * Moves all particles that are free to move for a single substep
+    * @param damping The damping to apply to the velocity each substep
+    * @param timestepSqr Delta time squared
+    * @param substep The fraction of the tick each substep covers
+    */
+    void IntegrateSubstep(float damping, float timestepSqr, float substep);
+
+    /**
+    * Derives the velocities of all particles from the solved substep
+    * @param substep The fraction of the tick each substep covers
+    */
+    void UpdateSubstepVelocities(float substep);
+
+    /**
+    * Restores the previous positions from the velocities after all substeps
+    */
+    void EndSubsteps();
+
+    /**
+    * Filters the y component of the position delta for all particles
+    * @note this is to prevent jittering of the convex hull algorithm
+    * and can be removed once Persistent contact caching is in place
+    */
+    void FilterPositions();
+
+    /**
+    * Clears the y filtering history of a particle
+    * @param index The index of the particle
+    */
+    void ResetFiltering(int index);
+
+    /**
+    * Hashes the bits of the current and previous positions so
+    * runs can be compared without storing every particle
+    * @return the FNV-1a hash of the particle state
+    */
+    unsigned long long GetStateHash() const;
+
+    std::vector<D3DXVECTOR3> positions;          ///< Current position in world coordinates of particle
+    std::vector<D3DXVECTOR3> previousPositions;  ///< Current previous position this tick
+    std::vector<D3DXVECTOR3> accelerations;      ///< Current acceleration of particle
+    std::vector<float> inverseMasses;            ///< One over the mass or zero if pinned or sleeping
+    std::vector<float> masses;                   ///< Mass of the particle regardless of its state
+    std::vector<D3DXVECTOR3> interactingVelocities; ///< Velocity of collisions resolved last tick
+    std::vector<D3DXVECTOR3> velocities;         ///< Velocity of particle when updating over substeps
+    std::vector<unsigned int> flags;             ///< State flags of the particle
+
+    std::vector<D3DXVECTOR3> positionDeltas;     ///< Change in position between current and previous positions
+    std::vector<D3DXVECTOR3> initialPositions;   ///< Initial position of particle
+    std::vector<D3DXVECTOR2> uvs;                ///< Texture uvs for the particle
+    std::vector<D3DXVECTOR3> colors;             ///< Color of the particle
+    std::vector<float> yFiltering;               ///< Ring buffer of recent y deltas held contiguously per particle
+    int filteringSlot;                           ///< Slot of the y filtering ring buffer written next
+    std::vector<std::shared_ptr<DynamicMesh>> collisions; ///< collision geometry for particle
+    float visualRadius;                          ///< Visual render radius for particle markers
+};
+
+/**
+* View of a single particle stored in the cloth particle data
 */
 class Particle
 {
@@ -19,20 +151,25 @@ public:
 
     /**
     * Constructor
-    * @param engine Callbacks from the rendering engine
     */
-    explicit Particle(EnginePtr engine);
+    Particle();
+
+    /**
+    * Constructor
+    * @param data The particle data holding the particle
+    * @param index The internal index of the particle
+    */
+    Particle(ParticleData& data, int index);
 
     /**
     * Create the particle
+    * @param engine Callbacks from the rendering engine
     * @param position The intial position of the particle
     * @param uv The uvs for the particle
-    * @param index The internal index of the particle
     * @param mesh The template collision mesh to copy
-    * @param visualRadius The radius to render the markers 
     */
-    void Initialise(const D3DXVECTOR3& position, const D3DXVECTOR2& uv, 
-        unsigned int index, const CollisionMesh& mesh, float visualRadius);
+    void Initialise(EnginePtr engine, const D3DXVECTOR3& position,
+        const D3DXVECTOR2& uv, const CollisionMesh& mesh);
 
     /**
     * Draws the particle visual mesh
@@ -40,7 +177,7 @@ public:
     * @param view The view matrix
     * @param position The position to set the visual mesh
     */
-    void DrawVisualMesh(const Matrix& projection, 
+    void DrawVisualMesh(const Matrix& projection,
         const Matrix& view, const D3DXVECTOR3& position);
 
     /**
@@ -69,7 +206,7 @@ public:
     /**
     * @return whether particle is pinned
     */
-    bool IsPinned() const { return m_pinned; };
+    bool IsPinned() const;
 
     /**
     * @param pin Set whether the particle is pinned
@@ -79,7 +216,7 @@ public:
     /**
     * @return whether particle is selected
     */
-    bool IsSelected() const { return m_selected; };
+    bool IsSelected() const;
 
     /**
     * @param select Set whether particle is selected
@@ -87,8 +224,10 @@ public:
     void SelectParticle(bool select);
 
     /**
-    * Move a particle explicitly
+    * Move a particle explicitly and update its collision
     * @param position The position to move to
+    * @note springs write the particle data directly and rely
+    *       on the collision being updated once before collision solving
     */
     void MovePosition(const D3DXVECTOR3& position);
 
@@ -100,24 +239,17 @@ public:
     /**
     * @return the internal index of the particle
     */
-    unsigned int GetIndex() const { return m_index; }
+    int GetIndex() const { return m_index; }
 
     /**
     * @return the position of the particle in world coordinates
     */
-    const D3DXVECTOR3& GetPosition() const { return m_position; }
+    const D3DXVECTOR3& GetPosition() const;
 
     /**
     * @return the uvs for the particle
     */
-    const D3DXVECTOR2& GetUVs() const { return m_uvs; }
-
-    /**
-    * Update the particles position
-    * @param damping The damping to apply to the movement
-    * @param timestepSqr Delta time squared
-    */
-    void PreCollisionUpdate(float damping, float timestepSqr);
+    const D3DXVECTOR2& GetUVs() const;
 
     /**
     * Sets the colour of the visual particle mesh
@@ -125,6 +257,11 @@ public:
     */
     void SetColor(const D3DXVECTOR3& colour);
 
+    /**
+    * Updates the particle's collision with the cached position if it has changed
+    */
+    void UpdateCollisionPosition();
+
     /**
     * Updates the required values post collision resolution
     */
@@ -138,36 +275,6 @@ public:
 
 private:
 
-    /**
-    * Updates the particle's collision with the cached position
-    */
-    void UpdateCollisionPosition();
-
-    /**
-    * Filters the y component of the position delta
-    * @note this is to prevent jittering of the convex hull algorithm
-    * and can be removed once Persistent contact caching is in place
-    */
-    void FilterPosition();
-
-    /**
-    * Prevent copying
-    */
-    Particle(const Particle&);
-    Particle& operator=(const Particle&);
-             
-    D3DXVECTOR3 m_positionDelta;                 ///< Change in position between current and previous positions
-    D3DXVECTOR3 m_previousPosition;              ///< Current previous position this tick
-    D3DXVECTOR3 m_position;                      ///< Current position in world coordinates of particle
-    D3DXVECTOR3 m_acceleration;                  ///< Current acceleration of particle
-    D3DXVECTOR3 m_initialPosition;               ///< Initial position of particle 
-    D3DXVECTOR2 m_uvs;                           ///< Texture uvs for the particle
-    Transform m_transform;                       ///< Current transform of particle
-    bool m_selected;                             ///< Whether particle is selected or not
-    bool m_pinned;                               ///< Whether particle is pinned or not
-    unsigned int m_index;                        ///< Internal index of the particle
-    D3DXVECTOR3 m_color;                         ///< Color of the particle
-    std::shared_ptr<DynamicMesh> m_collision;    ///< collision geometry for particle
-    float m_visualRadius;                        ///< Visual render radius for particle markers
-    std::deque<float> m_yFiltering;              ///< Filtering of the y component for position
-};
\ No newline at end of file
+    ParticleData* m_data;  ///< Data holding the particle state
+    int m_index;           ///< Internal index of the particle
+};
@@ -0,0 +1,280 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - projectivesolver.cpp
+////////////////////////////////////////////////////////////////////////////////////////
+
+#include "projectivesolver.h"
+#include "particle.h"
+#include "threadpool.h"
+#include <algorithm>
+
+namespace
+{
+    const float PIN_STIFFNESS = 1.0e4f;  ///< Weight holding pinned particles in place
+    const int SPRING_GRAIN = 256;        ///< Minimum springs given to a single thread
+}
+
+ProjectiveSolver::ProjectiveSolver() :
+    m_dirty(true),
+    m_factoredTimestep(0.0f),
+    m_factorisations(0)
+{
+    std::fill(m_stiffness, m_stiffness + Spring::MAX_TYPES, 1.0f);
+}
+
+void ProjectiveSolver::SetStiffness(Spring::Type type, float stiffness)
+{
+    m_stiffness[type] = stiffness;
+    m_dirty = true;
+}
+
+int ProjectiveSolver::GetFactorisations() const
+{
+    return m_factorisations;
+}
+
+void ProjectiveSolver::Initialise(const SpringBuffer& springs, int particleCount)
+{
+    // Only entries between a row's first connected particle and 
+    // the diagonal are stored; fill-in of the factor stays inside this
+    m_firstColumn.resize(particleCount);
+    for(int i = 0; i < particleCount; ++i)
+    {
+        m_firstColumn[i] = i;
+    }
+
+    for(int i = 0; i < springs.GetCount(); ++i)
+    {
+        const Spring& spring = springs.GetSpring(i);
+        const int lower = min(spring.particle1, spring.particle2);
+        const int upper = max(spring.particle1, spring.particle2);
+        m_firstColumn[upper] = min(m_firstColumn[upper], lower);
+    }
+
+    m_rowStart.resize(particleCount + 1);
+    m_rowStart[0] = 0;
+    for(int i = 0; i < particleCount; ++i)
+    {
+        m_rowStart[i+1] = m_rowStart[i] + (i - m_firstColumn[i]);
+    }
+
+    m_factor.resize(m_rowStart[particleCount]);
+    m_diagonal.resize(particleCount);
+    m_inertia.resize(particleCount);
+    m_inertial.resize(particleCount);
+    m_pinned.resize(particleCount);
+    m_projections.resize(springs.GetCount());
+    for(int axis = 0; axis < 3; ++axis)
+    {
+        m_rhs[axis].resize(particleCount);
+    }
+    m_dirty = true;
+}
+
+int ProjectiveSolver::GetEntry(int row, int column) const
+{
+    return m_rowStart[row] + (column - m_firstColumn[row]);
+}
+
+bool ProjectiveSolver::RequiresFactorisation(const ParticleData& particles, float timestep) const
+{
+    if(m_dirty || timestep != m_factoredTimestep)
+    {
+        return true;
+    }
+
+    // The timestep is unchanged so the inertia is recreated exactly as factored
+    const double timestepSqr = static_cast<double>(timestep) * timestep;
+    for(unsigned int i = 0; i < m_pinned.size(); ++i)
+    {
+        if(m_pinned[i] != ((particles.flags[i] & ParticleData::PINNED) != 0) ||
+            m_inertia[i] != particles.masses[i] / timestepSqr)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void ProjectiveSolver::Factorise(const ParticleData& particles, 
+                                 const SpringBuffer& springs, 
+                                 float timestep)
+{
+    const int count = static_cast<int>(m_diagonal.size());
+    const double timestepSqr = static_cast<double>(timestep) * timestep;
+
+    // Fill the lower triangle of the global matrix
+    std::fill(m_factor.begin(), m_factor.end(), 0.0);
+    for(int i = 0; i < count; ++i)
+    {
+        m_pinned[i] = (particles.flags[i] & ParticleData::PINNED) != 0;
+        m_inertia[i] = particles.masses[i] / timestepSqr;
+        m_diagonal[i] = m_inertia[i] + (m_pinned[i] ? PIN_STIFFNESS : 0.0);
+    }
+
+    for(int i = 0; i < springs.GetCount(); ++i)
+    {
+        const Spring& spring = springs.GetSpring(i);
+        const double stiffness = m_stiffness[springs.GetType(i)];
+        m_diagonal[spring.particle1] += stiffness;
+        m_diagonal[spring.particle2] += stiffness;
+        m_factor[GetEntry(max(spring.particle1, spring.particle2),
+            min(spring.particle1, spring.particle2))] -= stiffness;
+    }
+
+    // Skyline LDL' factorisation in place, row by row
+    for(int i = 0; i < count; ++i)
+    {
+        const int first = m_firstColumn[i];
+        double* row = &m_factor[0] + m_rowStart[i] - first;
+
+        // row[j] temporarily holds L(i,j)*D(j)
+        for(int j = first; j < i; ++j)
+        {
+            const double* other = &m_factor[0] + m_rowStart[j] - m_firstColumn[j];
+            double sum = row[j];
+            for(int k = max(first, m_firstColumn[j]); k < j; ++k)
+            {
+                sum -= row[k] * other[k];
+            }
+            row[j] = sum;
+        }
+
+        double diagonal = m_diagonal[i];
+        for(int j = first; j < i; ++j)
+        {
+            const double scaled = row[j];
+            row[j] = scaled / m_diagonal[j];
+            diagonal -= row[j] * scaled;
+        }
+        m_diagonal[i] = diagonal;
+    }
+
+    m_factoredTimestep = timestep;
+    m_dirty = false;
+    ++m_factorisations;
+}
+
+void ProjectiveSolver::BackSubstitute()
+{
+    const int count = static_cast<int>(m_diagonal.size());
+    for(int axis = 0; axis < 3; ++axis)
+    {
+        std::vector<double>& x = m_rhs[axis];
+
+        // Solve L z = b
+        for(int i = 0; i < count; ++i)
+        {
+            const double* row = &m_factor[0] + m_rowStart[i] - m_firstColumn[i];
+            double sum = x[i];
+            for(int j = m_firstColumn[i]; j < i; ++j)
+            {
+                sum -= row[j] * x[j];
+            }
+            x[i] = sum;
+        }
+
+        // Solve D y = z
+        for(int i = 0; i < count; ++i)
+        {
+            x[i] /= m_diagonal[i];
+        }
+
+        // Solve L' x = y
+        for(int i = count-1; i >= 0; --i)
+        {
+            const double* row = &m_factor[0] + m_rowStart[i] - m_firstColumn[i];
+            for(int j = m_firstColumn[i]; j < i; ++j)
+            {
+                x[j] -= row[j] * x[i];
+            }
+        }
+    }
+}
+
+void ProjectiveSolver::Solve(ParticleData& particles, 
+                             const SpringBuffer& springs,
+                             ThreadPool& pool, 
+                             int iterations,
+                             float damping, 
+                             float timestep)
+{
+    if(RequiresFactorisation(particles, timestep))
+    {
+        Factorise(particles, springs, timestep);
+    }
+
+    // Predict where each particle would move without any springs
+    const int count = static_cast<int>(m_diagonal.size());
+    const float timestepSqr = timestep * timestep;
+    for(int i = 0; i < count; ++i)
+    {
+        m_inertial[i] = particles.positions[i];
+        if(!(particles.flags[i] & (ParticleData::PINNED|ParticleData::COLLIDING)))
+        {
+            m_inertial[i] += ((particles.positions[i]-particles.previousPositions[i])*damping) 
+                + (particles.accelerations[i]*timestepSqr);
+        }
+        particles.previousPositions[i] = particles.positions[i];
+        MakeZeroVector(particles.accelerations[i]);
+    }
+
+    std::vector<D3DXVECTOR3>& positions = particles.positions;
+    for(int i = 0; i < count; ++i)
+    {
+        if(!m_pinned[i])
+        {
+            positions[i] = m_inertial[i];
+        }
+    }
+
+    for(int iteration = 0; iteration < max(iterations, 1); ++iteration)
+    {
+        // Local step: project each spring to its rest distance
+        pool.ParallelFor(springs.GetCount(), SPRING_GRAIN, 
+            [this, &springs, &positions](int begin, int end)
+            {
+                for(int i = begin; i < end; ++i)
+                {
+                    const Spring& spring = springs.GetSpring(i);
+                    D3DXVECTOR3 difference(positions[spring.particle2] - positions[spring.particle1]);
+                    const float length = D3DXVec3Length(&difference);
+                    m_projections[i] = length == 0.0f ? difference :
+                        difference * (spring.restDistance / length);
+                }
+            });
+
+        // Global step: solve the prefactored system for the new positions
+        for(int i = 0; i < count; ++i)
+        {
+            const double pin = m_pinned[i] ? PIN_STIFFNESS : 0.0;
+            m_rhs[0][i] = (m_inertia[i] * m_inertial[i].x) + (pin * positions[i].x);
+            m_rhs[1][i] = (m_inertia[i] * m_inertial[i].y) + (pin * positions[i].y);
+            m_rhs[2][i] = (m_inertia[i] * m_inertial[i].z) + (pin * positions[i].z);
+        }
+
+        for(int i = 0; i < springs.GetCount(); ++i)
+        {
+            const Spring& spring = springs.GetSpring(i);
+            const double stiffness = m_stiffness[springs.GetType(i)];
+            const D3DXVECTOR3& projection = m_projections[i];
+            m_rhs[0][spring.particle1] -= stiffness * projection.x;
+            m_rhs[1][spring.particle1] -= stiffness * projection.y;
+            m_rhs[2][spring.particle1] -= stiffness * projection.z;
+            m_rhs[0][spring.particle2] += stiffness * projection.x;
+            m_rhs[1][spring.particle2] += stiffness * projection.y;
+            m_rhs[2][spring.particle2] += stiffness * projection.z;
+        }
+
+        BackSubstitute();
+
+        for(int i = 0; i < count; ++i)
+        {
+            if(!m_pinned[i])
+            {
+                positions[i].x = static_cast<float>(m_rhs[0][i]);
+                positions[i].y = static_cast<float>(m_rhs[1][i]);
+                positions[i].z = static_cast<float>(m_rhs[2][i]);
+            }
+        }
+    }
+}
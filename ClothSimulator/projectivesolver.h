@@ -0,0 +1,107 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - projectivesolver.h
+////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include "common.h"
+#include "spring.h"
+
+struct ParticleData;
+class ThreadPool;
+
+/**
+* Projective dynamics solver for the cloth springs. Alternates a local step
+* projecting each spring to its rest distance with a global step solving
+* (M/h^2 + sum k A'A) x = M/h^2 s + sum k A'p. The global matrix only depends
+* on the topology, timestep and pinned particles so it is factored once
+* into a skyline LDL' and reused every tick until one of those changes.
+*/
+class ProjectiveSolver
+{
+public:
+
+    /**
+    * Constructor
+    */
+    ProjectiveSolver();
+
+    /**
+    * Builds the skyline structure of the global matrix from the springs
+    * @param springs The springs connecting the particles
+    * @param particleCount The number of particles the springs connect
+    */
+    void Initialise(const SpringBuffer& springs, int particleCount);
+
+    /**
+    * Moves the particles for a single tick
+    * @param particles The particle data to update
+    * @param springs The springs connecting the particles
+    * @param pool The threads to solve with
+    * @param iterations The number of local/global iterations to run
+    * @param damping The damping to apply to the movement
+    * @param timestep The timestep of the cloth
+    */
+    void Solve(ParticleData& particles, const SpringBuffer& springs,
+        ThreadPool& pool, int iterations, float damping, float timestep);
+
+    /**
+    * Sets the weight for all springs of a type
+    * @param type The type of spring to set
+    * @param stiffness How strongly the spring pulls towards its rest distance
+    * @note requires the global matrix to be factored again
+    */
+    void SetStiffness(Spring::Type type, float stiffness);
+
+    /**
+    * @return the number of times the global matrix has been factored
+    */
+    int GetFactorisations() const;
+
+private:
+
+    /**
+    * Fills and factors the global matrix for the current timestep and pinning
+    * @param particles The particle data to update
+    * @param springs The springs connecting the particles
+    * @param timestep The timestep of the cloth
+    */
+    void Factorise(const ParticleData& particles, 
+        const SpringBuffer& springs, float timestep);
+
+    /**
+    * @return whether the factored matrix no longer matches the cloth
+    * @param particles The particle data to update
+    * @param timestep The timestep of the cloth
+    */
+    bool RequiresFactorisation(const ParticleData& particles, float timestep) const;
+
+    /**
+    * Solves the factored system in place using the right hand side
+    */
+    void BackSubstitute();
+
+    /**
+    * @return the index of the entry for row/column in the skyline storage
+    */
+    int GetEntry(int row, int column) const;
+
+    /**
+    * Prevent copying
+    */
+    ProjectiveSolver(const ProjectiveSolver&);
+    ProjectiveSolver& operator=(const ProjectiveSolver&);
+
+    float m_stiffness[Spring::MAX_TYPES];    ///< Weight for each type of spring
+    bool m_dirty;                            ///< Whether the matrix requires factoring
+    float m_factoredTimestep;                ///< Timestep the matrix was factored with
+    int m_factorisations;                    ///< Number of times the matrix has been factored
+    std::vector<unsigned char> m_pinned;     ///< Particles pinned when the matrix was factored
+    std::vector<int> m_firstColumn;          ///< First stored column of each row
+    std::vector<int> m_rowStart;             ///< Offset of each row into the skyline
+    std::vector<double> m_factor;            ///< Strictly lower triangle L of the factor
+    std::vector<double> m_diagonal;          ///< Diagonal D of the factor
+    std::vector<double> m_inertia;           ///< Mass over timestep squared for each particle
+    std::vector<D3DXVECTOR3> m_inertial;     ///< Predicted position without any springs
+    std::vector<D3DXVECTOR3> m_projections;  ///< Spring vector projected to its rest distance
+    std::vector<double> m_rhs[3];            ///< Right hand side and solution of each axis
+};
@@ -100,16 +100,22 @@ public:
     void ManipulatorPickingTest(Picking& picking);
 
     /**
-    * Updates the state of the scene pre collision solving
+    * Updates the manipulator and diagnostics of the scene once a frame
     * @param pressed Whether the mouse is currently being pressed
     * @param direction The mouse movement direction
     * @param world The camera world matrix
     * @param invProjection The camera inverse projection matrix
     * @param deltatime The time passed since last frame in seconds
     */
-    void PreCollisionUpdate(bool pressed, const D3DXVECTOR2& direction,
+    void Update(bool pressed, const D3DXVECTOR2& direction,
         const Matrix& world, const Matrix& invProjection, float deltatime);
 
+    /**
+    * Updates the state of the scene pre collision solving
+    * @param deltatime The time passed since the last physics step in seconds
+    */
+    void PreCollisionUpdate(float deltatime);
+
     /**
     * Updates the state of the scene post collision solving
     */
@@ -28,24 +28,24 @@ Shader::~Shader()
     }
 }
 
-bool Shader::Load(LPDIRECT3DDEVICE9 d3ddev, const std::string& filename)
+bool Shader::Load(LPDIRECT3DDEVICE9 d3ddev, const std::string& filename, std::string& errorBuffer)
 {
     ID3DXBuffer* errorlog = nullptr;
     if(FAILED(D3DXCreateEffectFromFile(d3ddev,filename.c_str(), 0, 0,
         D3DXSHADER_ENABLE_BACKWARDS_COMPATIBILITY, 0, &m_effect, &errorlog)))
     {
-        std::string errorMessage("Shader " + filename + " has failed!");
+        errorBuffer = "Shader " + filename + " has failed!";
         if(errorlog)
         {
-            errorMessage += (char*)errorlog->GetBufferPointer();
+            errorBuffer += (char*)errorlog->GetBufferPointer();
+            errorlog->Release();
         }
-        ShowMessageBox(errorMessage);
         return false;
     }
     return true;
 }
 
-bool ShaderManager::Inititalise(LPDIRECT3DDEVICE9 d3ddev)
+bool ShaderManager::Inititalise(LPDIRECT3DDEVICE9 d3ddev, std::string& errorBuffer)
 {
     const std::string ShaderFolder(".\\Resources\\Shaders\\");
 
@@ -54,11 +54,11 @@ bool ShaderManager::Inititalise(LPDIRECT3DDEVICE9 d3ddev)
         [](){ return std::unique_ptr<Shader>(new Shader()); });
     
     bool success = true;
-    success = (success ? m_shaders[MAIN_SHADER]->Load(d3ddev,ShaderFolder+"main.fx") : false);
-    success = (success ? m_shaders[CLOTH_SHADER]->Load(d3ddev,ShaderFolder+"cloth.fx") : false);
-    success = (success ? m_shaders[BOUNDS_SHADER]->Load(d3ddev,ShaderFolder+"bounds.fx") : false);
-    success = (success ? m_shaders[TOOL_SHADER]->Load(d3ddev,ShaderFolder+"tool.fx") : false);
-    success = (success ? m_shaders[GROUND_SHADER]->Load(d3ddev,ShaderFolder+"ground.fx") : false);
+    success = (success ? m_shaders[MAIN_SHADER]->Load(d3ddev,ShaderFolder+"main.fx",errorBuffer) : false);
+    success = (success ? m_shaders[CLOTH_SHADER]->Load(d3ddev,ShaderFolder+"cloth.fx",errorBuffer) : false);
+    success = (success ? m_shaders[BOUNDS_SHADER]->Load(d3ddev,ShaderFolder+"bounds.fx",errorBuffer) : false);
+    success = (success ? m_shaders[TOOL_SHADER]->Load(d3ddev,ShaderFolder+"tool.fx",errorBuffer) : false);
+    success = (success ? m_shaders[GROUND_SHADER]->Load(d3ddev,ShaderFolder+"ground.fx",errorBuffer) : false);
     return success;
 }
 
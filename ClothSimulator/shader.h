@@ -26,9 +26,10 @@ public:
     * Loads the shader
     * @param d3ddev The directX device
     * @param filename The filename of the shader
+    * @param errorBuffer Filled with the compile errors if loading failed
     * @return whether loading was successful
     */
-    bool Load(LPDIRECT3DDEVICE9 d3ddev, const std::string& filename);
+    bool Load(LPDIRECT3DDEVICE9 d3ddev, const std::string& filename, std::string& errorBuffer);
 
     /**
     * @return the DirectX Shader effect
@@ -78,9 +79,11 @@ public:
 
     /**
     * Initialise all shaders
+    * @param d3ddev The directX device
+    * @param errorBuffer Filled with the shader that failed and why
     * @return whether initialisation succeeded
     */
-    bool Inititalise(LPDIRECT3DDEVICE9 d3ddev);
+    bool Inititalise(LPDIRECT3DDEVICE9 d3ddev, std::string& errorBuffer);
 
     /**
     * @param shader The shader to get
@@ -14,6 +14,7 @@
 #include "scene.h"
 #include "octree.h"
 #include "collisionsolver.h"
+#include "threadpool.h"
 #include <algorithm>
 #include <sstream>
 
@@ -22,6 +23,20 @@ namespace
     const float CAMERA_MOVE_SPEED = 40.0f;  ///< Speed the camera will translate
     const float CAMERA_ROT_SPEED = 2.0f;    ///< Speed the camera will rotate
     const float HANDLE_SPEED = 20.0f;       ///< Speed the cloth will move in handle mode
+    const std::string CLOTH_MESH(".\\Resources\\Models\\disc.obj"); ///< Mesh loaded as cloth
+
+    /**
+    * Offsets from the starting position for each cloth added
+    */
+    const D3DXVECTOR3 CLOTH_OFFSETS[] = 
+    {
+        D3DXVECTOR3(0.0f, 0.0f, 0.0f),
+        D3DXVECTOR3(-20.0f, 0.0f, 0.0f),
+        D3DXVECTOR3(20.0f, 0.0f, 0.0f),
+        D3DXVECTOR3(0.0f, 0.0f, 20.0f),
+        D3DXVECTOR3(0.0f, 0.0f, -20.0f)
+    };
+    const int MAX_CLOTHS = sizeof(CLOTH_OFFSETS) / sizeof(CLOTH_OFFSETS[0]);
 
     const D3DCOLOR BACK_BUFFER_COLOR(D3DCOLOR_XRGB(190, 190, 195)); 
     const D3DCOLOR RENDER_COLOR(D3DCOLOR_XRGB(0, 0, 255));          
@@ -30,6 +45,9 @@ namespace
 
 Simulation::Simulation() :
     m_drawCollisions(false),
+    m_drawVertices(false),
+    m_handleMode(false),
+    m_selectedCloth(0),
     m_d3ddev(nullptr)
 {
 }
@@ -51,8 +69,11 @@ void Simulation::Render()
 
     D3DXVECTOR3 cameraPosition(m_camera->World().Position());
     m_scene->Draw(cameraPosition, m_camera->Projection(), m_camera->View());
-    m_cloth->Draw(cameraPosition, m_camera->Projection(), m_camera->View());
-    m_cloth->DrawCollisions(m_camera->Projection(), m_camera->View());
+    for(const auto& cloth : m_cloths)
+    {
+        cloth->Draw(cameraPosition, m_camera->Projection(), m_camera->View());
+        cloth->DrawCollisions(m_camera->Projection(), m_camera->View());
+    }
     m_scene->DrawCollisions(m_camera->Projection(), m_camera->View());
     m_scene->DrawTools(cameraPosition, m_camera->Projection(), m_camera->View());
     m_octree->RenderDiagnostics();
@@ -78,22 +99,61 @@ void Simulation::Update()
     {
         m_input->UpdatePicking(m_camera->Projection(), m_camera->World());
         m_scene->ManipulatorPickingTest(m_input->GetMousePicking());
-        m_cloth->MousePickingTest(m_input->GetMousePicking());
+        for(const auto& cloth : m_cloths)
+        {
+            cloth->MousePickingTest(m_input->GetMousePicking());
+        }
         m_scene->ScenePickingTest(m_input->GetMousePicking());
         m_input->SolvePicking();
     }
 
-    const float deltatime = m_timer->GetDeltaTime();
+    const float deltatime = m_timer->GetPhysicsStep();
     const bool pressed = m_input->IsClickPreventionActive() 
         ? false : m_input->IsMousePressed();
 
-    m_cloth->PreCollisionUpdate(deltatime);
-    m_scene->PreCollisionUpdate(pressed, m_input->GetMouseDirection(),
-        m_camera->World(), m_camera->InverseProjection(), deltatime);
+    GetSelectedCloth().UpdateDiagnostics();
+    m_diagnostics->UpdateText(Diagnostic::CLOTH, "SelectedCloth", Diagnostic::WHITE, 
+        StringCast(m_selectedCloth+1) + " of " + StringCast(m_cloths.size()));
+
+    // Changing the simulated grid recreates particles in the shared octree
+    const D3DXVECTOR3 cameraPosition(m_camera->World().Position());
+    for(const auto& cloth : m_cloths)
+    {
+        cloth->UpdateLevelOfDetail(cameraPosition);
+    }
+
+    auto updateCloths = [this, deltatime](int begin, int end)
+    {
+        for(int i = begin; i < end; ++i)
+        {
+            m_cloths[i]->PreCollisionUpdate(deltatime);
+        }
+    };
+
+    // Mouse movement is measured over the whole frame so is only applied once
+    m_scene->Update(pressed, m_input->GetMouseDirection(), m_camera->World(), 
+        m_camera->InverseProjection(), m_timer->GetDeltaTime());
+
+    for(int step = 0; step < m_timer->GetPhysicsSteps(); ++step)
+    {
+        // Cloths share nothing until their collisions are solved
+        m_threadpool->ParallelFor(static_cast<int>(m_cloths.size()), 1, updateCloths);
+        m_scene->PreCollisionUpdate(deltatime);
+
+        // Updating the collisions moves them within the shared octree
+        m_scene->SolveCollisions();
+        for(const auto& cloth : m_cloths)
+        {
+            cloth->PostCollisionUpdate();
+        }
+        m_scene->PostCollisionUpdate();
+    }
 
-    m_scene->SolveCollisions();
-    m_cloth->PostCollisionUpdate();
-    m_scene->PostCollisionUpdate();
+    // Render the cloth part way to the next physics step
+    for(const auto& cloth : m_cloths)
+    {
+        cloth->UpdateVertexBuffer(m_timer->GetInterpolation());
+    }
 
     D3DPERF_EndEvent();
 }
@@ -103,12 +163,36 @@ void Simulation::LoadGuiCallbacks(GuiCallbacks* callbacks)
     using namespace std::placeholders;
     m_scene->LoadGuiCallbacks(callbacks);
 
-    callbacks->setGravity = std::bind(&Cloth::SetSimulation, m_cloth.get(), _1);
-    callbacks->resetCloth = std::bind(&Cloth::Reset, m_cloth.get());
-    callbacks->unpinCloth = std::bind(&Cloth::UnpinCloth, m_cloth.get());
+    // Toggles for the scene are shared between all cloths
+    callbacks->setGravity = [this](bool simulating)
+    {
+        for(const auto& cloth : m_cloths)
+        {
+            cloth->SetSimulation(simulating);
+        }
+    };
+
+    callbacks->setVertsVisible = [this](bool visible)
+    {
+        m_drawVertices = visible;
+        for(const auto& cloth : m_cloths)
+        {
+            cloth->SetVertexVisibility(visible);
+        }
+    };
+
+    callbacks->setHandleMode = [this](bool handleMode)
+    {
+        m_handleMode = handleMode;
+        for(const auto& cloth : m_cloths)
+        {
+            cloth->SetHandleMode(handleMode);
+        }
+    };
+
+    callbacks->resetCloth = [this](){ GetSelectedCloth().Reset(); };
+    callbacks->unpinCloth = [this](){ GetSelectedCloth().UnpinCloth(); };
     callbacks->resetCamera = std::bind(&Camera::Reset, m_camera.get());
-    callbacks->setVertsVisible = std::bind(&Cloth::SetVertexVisibility, m_cloth.get(), _1);
-    callbacks->setHandleMode = std::bind(&Cloth::SetHandleMode, m_cloth.get(), _1);
     callbacks->setWireframeMode = std::bind(&Diagnostic::SetWireframe, m_diagnostics.get(), _1);
 
     callbacks->createBox = std::bind(&Scene::AddObject, m_scene.get(), Scene::BOX);
@@ -116,15 +200,46 @@ void Simulation::LoadGuiCallbacks(GuiCallbacks* callbacks)
     callbacks->createCylinder = std::bind(&Scene::AddObject, m_scene.get(), Scene::CYLINDER);
     callbacks->clearScene = std::bind(&Scene::RemoveScene, m_scene.get());
 
-    callbacks->setTimestep = std::bind(&Cloth::SetTimeStep, m_cloth.get(), _1);
-    callbacks->setVertexRows = std::bind(&Cloth::SetVertexRows, m_cloth.get(), _1);
-    callbacks->setIterations = std::bind(&Cloth::SetIterations, m_cloth.get(), _1);
-    callbacks->setSpacing = std::bind(&Cloth::SetSpacing, m_cloth.get(), _1);
+    // Parameters only change the cloth currently selected
+    callbacks->setTimestep = [this](double value){ GetSelectedCloth().SetTimeStep(value); };
+    callbacks->setVertexRows = [this](double value){ GetSelectedCloth().SetVertexRows(value); };
+    callbacks->setIterations = [this](double value){ GetSelectedCloth().SetIterations(value); };
+    callbacks->setSpacing = [this](double value){ GetSelectedCloth().SetSpacing(value); };
 
-    callbacks->getSpacing = std::bind(&Cloth::GetSpacing, m_cloth.get());
-    callbacks->getIterations = std::bind(&Cloth::GetIterations, m_cloth.get());
-    callbacks->getVertexRows = std::bind(&Cloth::GetVertexRows, m_cloth.get());
-    callbacks->getTimestep = std::bind(&Cloth::GetTimeStep, m_cloth.get());
+    callbacks->getSpacing = [this](){ return GetSelectedCloth().GetSpacing(); };
+    callbacks->getIterations = [this](){ return GetSelectedCloth().GetIterations(); };
+    callbacks->getVertexRows = [this](){ return GetSelectedCloth().GetVertexRows(); };
+    callbacks->getTimestep = [this](){ return GetSelectedCloth().GetTimeStep(); };
+}
+
+Cloth& Simulation::GetSelectedCloth()
+{
+    return *m_cloths[m_selectedCloth];
+}
+
+void Simulation::SelectNextCloth()
+{
+    m_selectedCloth = (m_selectedCloth + 1) % static_cast<int>(m_cloths.size());
+}
+
+void Simulation::AddCloth()
+{
+    const int index = static_cast<int>(m_cloths.size());
+    if(index < MAX_CLOTHS)
+    {
+        std::shared_ptr<Cloth> cloth(new Cloth(m_engine, CLOTH_OFFSETS[index]));
+        if(index > 0)
+        {
+            cloth->SetSimulation(m_cloths.front()->IsSimulating());
+        }
+        cloth->SetVertexVisibility(m_drawVertices);
+        cloth->SetCollisionVisibility(m_drawCollisions);
+        cloth->SetHandleMode(m_handleMode);
+
+        m_solver->AddCloth(cloth);
+        m_cloths.push_back(cloth);
+        m_selectedCloth = index;
+    }
 }
 
 bool Simulation::CreateSimulation(HINSTANCE hInstance, HWND hWnd, LPDIRECT3DDEVICE9 d3ddev) 
@@ -133,12 +248,15 @@ bool Simulation::CreateSimulation(HINSTANCE hInstance, HWND hWnd, LPDIRECT3DDEVI
     m_diagnostics.reset(new Diagnostic());
     m_shader.reset(new ShaderManager());
     m_light.reset(new LightManager());
+    m_threadpool.reset(new ThreadPool());
 
     // Create the engine callbacks
     EnginePtr engine(new Engine());
+    m_engine = engine;
     engine->device = [this](){ return m_d3ddev; };
     engine->diagnostic = [this](){ return m_diagnostics.get(); };
     engine->octree = [this](){ return m_octree.get(); };
+    engine->threadpool = [this](){ return m_threadpool.get(); };
     
     engine->getShader = std::bind(&ShaderManager::GetShader, 
         m_shader.get(), std::placeholders::_1);
@@ -153,7 +271,14 @@ bool Simulation::CreateSimulation(HINSTANCE hInstance, HWND hWnd, LPDIRECT3DDEVI
     m_camera->CreateProjectionMatrix();
 
     // Initialise the shaders/lights
-    if(!m_shader->Inititalise(d3ddev) || !m_light->Inititalise())
+    std::string errorBuffer;
+    if(!m_shader->Inititalise(d3ddev, errorBuffer))
+    {
+        ShowMessageBox(errorBuffer);
+        return false;
+    }
+
+    if(!m_light->Inititalise())
     {
         return false;
     }
@@ -168,9 +293,9 @@ bool Simulation::CreateSimulation(HINSTANCE hInstance, HWND hWnd, LPDIRECT3DDEVI
     m_octree.reset(octree);
 
     // Initialise the simulation
-    m_cloth.reset(new Cloth(engine));
-    m_solver.reset(new CollisionSolver(engine, m_cloth));
+    m_solver.reset(new CollisionSolver(engine));
     m_scene.reset(new Scene(engine, m_solver));
+    AddCloth();
 
     // Hook up the solver to the octree
     octree->SetIteratorFunction(std::bind(&CollisionSolver::SolveObjectCollision, 
@@ -219,47 +344,64 @@ void Simulation::LoadInput(HINSTANCE hInstance, HWND hWnd, EnginePtr engine)
     m_input->AddClickPreventionKey(DIK_LALT);
     
     // Controlling the cloth
-    m_input->SetKeyCallback(DIK_A, true, [this](){ m_cloth->MovePinnedRow(
+    m_input->SetKeyCallback(DIK_A, true, [this](){ GetSelectedCloth().MovePinnedRow(
         -m_timer->GetDeltaTime()*HANDLE_SPEED, 0.0f, 0.0f); });
     
-    m_input->SetKeyCallback(DIK_D, true, [this](){ m_cloth->MovePinnedRow(
+    m_input->SetKeyCallback(DIK_D, true, [this](){ GetSelectedCloth().MovePinnedRow(
         m_timer->GetDeltaTime()*HANDLE_SPEED, 0.0f, 0.0f); });
     
-    m_input->SetKeyCallback(DIK_S, true, [this](){ m_cloth->MovePinnedRow(
+    m_input->SetKeyCallback(DIK_S, true, [this](){ GetSelectedCloth().MovePinnedRow(
         0.0f, -m_timer->GetDeltaTime()*HANDLE_SPEED, 0.0f); });
     
-    m_input->SetKeyCallback(DIK_W, true, [this](){ m_cloth->MovePinnedRow(
+    m_input->SetKeyCallback(DIK_W, true, [this](){ GetSelectedCloth().MovePinnedRow(
         0.0f, m_timer->GetDeltaTime()*HANDLE_SPEED, 0.0f); });
     
-    m_input->SetKeyCallback(DIK_Q, true, [this](){ m_cloth->MovePinnedRow(
+    m_input->SetKeyCallback(DIK_Q, true, [this](){ GetSelectedCloth().MovePinnedRow(
         0.0f, 0.0f, -m_timer->GetDeltaTime()*HANDLE_SPEED); });
     
-    m_input->SetKeyCallback(DIK_E, true, [this](){ m_cloth->MovePinnedRow(
+    m_input->SetKeyCallback(DIK_E, true, [this](){ GetSelectedCloth().MovePinnedRow(
         0.0f, 0.0f, m_timer->GetDeltaTime()*HANDLE_SPEED); });
     
     // Changing the cloth row selected
     m_input->SetKeyCallback(DIK_1, false, 
-        [this](){ m_cloth->ChangeRow(1); });
+        [this](){ GetSelectedCloth().ChangeRow(1); });
     
     m_input->SetKeyCallback(DIK_2, false, 
-        [this](){ m_cloth->ChangeRow(2); });
+        [this](){ GetSelectedCloth().ChangeRow(2); });
     
     m_input->SetKeyCallback(DIK_3, false, 
-        [this](){ m_cloth->ChangeRow(3); });
+        [this](){ GetSelectedCloth().ChangeRow(3); });
     
     m_input->SetKeyCallback(DIK_4, false, 
-        [this](){ m_cloth->ChangeRow(4); });
+        [this](){ GetSelectedCloth().ChangeRow(4); });
     
     // Scene shortcut keys
     m_input->SetKeyCallback(DIK_BACKSPACE, false,
         std::bind(&Scene::RemoveObject, m_scene.get()));
 
+    // Adding and switching between cloths
+    m_input->SetKeyCallback(DIK_C, false, 
+        std::bind(&Simulation::AddCloth, this));
+
+    m_input->SetKeyCallback(DIK_TAB, false, 
+        std::bind(&Simulation::SelectNextCloth, this));
+
+    m_input->SetKeyCallback(DIK_M, false, 
+        [this]()
+        {
+            std::string errorBuffer;
+            if(!GetSelectedCloth().LoadMesh(CLOTH_MESH, errorBuffer))
+            {
+                ShowMessageBox(errorBuffer);
+            }
+        });
+
     // Cloth smoothing
     m_input->SetKeyCallback(DIK_EQUALS, true, 
-        std::bind(&Cloth::ChangeSmoothing, m_cloth.get(), true));
+        [this](){ GetSelectedCloth().ChangeSmoothing(true); });
 
     m_input->SetKeyCallback(DIK_MINUS, true, 
-        std::bind(&Cloth::ChangeSmoothing, m_cloth.get(), false));
+        [this](){ GetSelectedCloth().ChangeSmoothing(false); });
 
     // Setting deltatime explicitly
     m_input->SetKeyCallback(DIK_P, false, 
@@ -270,6 +412,29 @@ void Simulation::LoadInput(HINSTANCE hInstance, HWND hWnd, EnginePtr engine)
 
     m_input->SetKeyCallback(DIK_LBRACKET, true, 
         std::bind(&Timer::ChangeDeltatime, m_timer.get(), false));
+
+    // Changing the fixed physics step
+    m_input->SetKeyCallback(DIK_U, false, 
+        std::bind(&Timer::ChangePhysicsRate, m_timer.get()));
+
+    // Switching the cloth solver
+    m_input->SetKeyCallback(DIK_O, false, 
+        [this](){ GetSelectedCloth().ChangeSolver(); });
+
+    m_input->SetKeyCallback(DIK_I, false, 
+        [this](){ GetSelectedCloth().ToggleAdaptiveIterations(); });
+
+    m_input->SetKeyCallback(DIK_R, false, 
+        [this](){ GetSelectedCloth().ToggleTearing(); });
+
+    m_input->SetKeyCallback(DIK_L, false, 
+        [this](){ GetSelectedCloth().ToggleAttachments(); });
+
+    m_input->SetKeyCallback(DIK_K, false, 
+        [this](){ GetSelectedCloth().ToggleWind(); });
+
+    m_input->SetKeyCallback(DIK_J, false, 
+        [this](){ GetSelectedCloth().ChangeSimulationLevel(); });
     
     // Toggling Diagnostic drawing
     m_input->SetKeyCallback(DIK_T, false, 
@@ -296,7 +461,10 @@ void Simulation::LoadInput(HINSTANCE hInstance, HWND hWnd, EnginePtr engine)
     m_input->SetKeyCallback(DIK_0, false, [this]()
     {
         m_drawCollisions = !m_drawCollisions;
-        m_cloth->SetCollisionVisibility(m_drawCollisions);
+        for(const auto& cloth : m_cloths)
+        {
+            cloth->SetCollisionVisibility(m_drawCollisions);
+        }
         m_scene->SetCollisionVisibility(m_drawCollisions);
     });
 
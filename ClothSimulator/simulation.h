@@ -15,6 +15,7 @@ class Cloth;
 class Input;
 class Timer;
 class Octree;
+class ThreadPool;
 
 /**
 * Main Simulation Class
@@ -74,6 +75,22 @@ private:
     */
     void LoadInput(HINSTANCE hInstance, HWND hWnd, EnginePtr engine);
 
+    /**
+    * Adds another cloth to the scene if there is room
+    * and makes it the cloth being controlled
+    */
+    void AddCloth();
+
+    /**
+    * Switches to controlling the next cloth in the scene
+    */
+    void SelectNextCloth();
+
+    /**
+    * @return the cloth controlled by the keys and gui
+    */
+    Cloth& GetSelectedCloth();
+
     /**
     * Prevent copying
     */
@@ -84,12 +101,17 @@ private:
     std::unique_ptr<ShaderManager> m_shader;     ///< Manager for the simulation shaders
     std::shared_ptr<CollisionSolver> m_solver;   ///< Collision solver for cloth
     std::unique_ptr<Timer> m_timer;              ///< Simulation timer object
-    std::shared_ptr<Cloth> m_cloth;              ///< Simulation cloth object
+    std::vector<std::shared_ptr<Cloth>> m_cloths;///< Simulation cloth objects
     std::unique_ptr<Input> m_input;              ///< Simulation input object
     std::unique_ptr<Camera> m_camera;            ///< Main camera
     std::unique_ptr<Scene> m_scene;              ///< Mesh manager for the scene
     std::unique_ptr<Diagnostic> m_diagnostics;   ///< Diagnostic renderer
     std::unique_ptr<Octree> m_octree;            ///< Octree spatial partitining
+    std::unique_ptr<ThreadPool> m_threadpool;    ///< Worker threads for the simulation
+    EnginePtr m_engine;                          ///< Callbacks for the rendering engine
     LPDIRECT3DDEVICE9 m_d3ddev;                  ///< DirectX device
+    int m_selectedCloth;                         ///< Cloth controlled by the keys and gui
     bool m_drawCollisions;                       ///< Whether to display collision models
+    bool m_drawVertices;                         ///< Whether to display the cloth vertices
+    bool m_handleMode;                           ///< Whether the cloths are in handle mode
 };
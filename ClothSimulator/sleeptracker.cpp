@@ -0,0 +1,228 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - sleeptracker.cpp
+////////////////////////////////////////////////////////////////////////////////////////
+
+#include "sleeptracker.h"
+#include "particle.h"
+#include "spring.h"
+#include <algorithm>
+#include <assert.h>
+
+namespace
+{
+    const int TILE_SIZE = 8;              ///< Number of particles in a row/column of a grid tile
+    const int SLEEP_TICKS = 60;           ///< Ticks a tile must be at rest before sleeping
+    const float SLEEP_DISTANCE = 0.001f;  ///< Movement in a tick below which a particle is at rest
+}
+
+SleepTracker::SleepTracker() :
+    m_sleepingTiles(0)
+{
+}
+
+bool SleepTracker::IsAsleep() const
+{
+    return !m_asleep.empty() && m_sleepingTiles == static_cast<int>(m_asleep.size());
+}
+
+int SleepTracker::GetSleepingTiles() const
+{
+    return m_sleepingTiles;
+}
+
+int SleepTracker::GetTileCount() const
+{
+    return static_cast<int>(m_asleep.size());
+}
+
+void SleepTracker::Initialise(ParticleData& particles, int rows)
+{
+    const int tileRows = (rows + TILE_SIZE - 1) / TILE_SIZE;
+    m_tiles.resize(particles.positions.size());
+    for(int x = 0; x < rows; ++x)
+    {
+        for(int y = 0; y < rows; ++y)
+        {
+            m_tiles[(x * rows) + y] = ((x / TILE_SIZE) * tileRows) + (y / TILE_SIZE);
+        }
+    }
+
+    // Each tile is kept awake by the surrounding tiles as 
+    // any movement there will soon pull it along through the springs
+    std::vector<std::vector<int>> neighbours(tileRows * tileRows);
+    for(int x = 0; x < tileRows; ++x)
+    {
+        for(int y = 0; y < tileRows; ++y)
+        {
+            auto& tileNeighbours = neighbours[(x * tileRows) + y];
+            for(int i = max(x-1, 0); i <= min(x+1, tileRows-1); ++i)
+            {
+                for(int j = max(y-1, 0); j <= min(y+1, tileRows-1); ++j)
+                {
+                    tileNeighbours.push_back((i * tileRows) + j);
+                }
+            }
+        }
+    }
+
+    CreateTiles(particles, neighbours);
+}
+
+void SleepTracker::Initialise(ParticleData& particles, const SpringBuffer& springs)
+{
+    const int particleCount = static_cast<int>(particles.positions.size());
+    const int tileParticles = TILE_SIZE * TILE_SIZE;
+    const int tileCount = (particleCount + tileParticles - 1) / tileParticles;
+
+    m_tiles.resize(particleCount);
+    for(int i = 0; i < particleCount; ++i)
+    {
+        m_tiles[i] = i / tileParticles;
+    }
+
+    std::vector<std::vector<int>> neighbours(tileCount);
+    for(int tile = 0; tile < tileCount; ++tile)
+    {
+        neighbours[tile].push_back(tile);
+    }
+
+    for(int i = 0; i < springs.GetCount(); ++i)
+    {
+        const Spring& spring = springs.GetSpring(i);
+        const int tileA = m_tiles[spring.particle1];
+        const int tileB = m_tiles[spring.particle2];
+        if(tileA != tileB)
+        {
+            neighbours[tileA].push_back(tileB);
+            neighbours[tileB].push_back(tileA);
+        }
+    }
+
+    for(auto& tileNeighbours : neighbours)
+    {
+        std::sort(tileNeighbours.begin(), tileNeighbours.end());
+        tileNeighbours.erase(std::unique(tileNeighbours.begin(),
+            tileNeighbours.end()), tileNeighbours.end());
+    }
+
+    CreateTiles(particles, neighbours);
+}
+
+void SleepTracker::CreateTiles(ParticleData& particles, 
+                               const std::vector<std::vector<int>>& neighbours)
+{
+    const int tileCount = static_cast<int>(neighbours.size());
+    m_sleepingTiles = 0;
+    m_movement.assign(tileCount, 0.0f);
+    m_restingTicks.assign(tileCount, 0);
+    m_asleep.assign(tileCount, 0);
+
+    // Group the particles by tile so each tile can be woken or slept in one pass
+    m_tileParticles.assign(tileCount, std::vector<int>());
+    for(unsigned int i = 0; i < m_tiles.size(); ++i)
+    {
+        m_tileParticles[m_tiles[i]].push_back(static_cast<int>(i));
+    }
+
+    m_neighbourStart.assign(1, 0);
+    m_neighbours.clear();
+    for(const auto& tileNeighbours : neighbours)
+    {
+        m_neighbours.insert(m_neighbours.end(), tileNeighbours.begin(), tileNeighbours.end());
+        m_neighbourStart.push_back(static_cast<int>(m_neighbours.size()));
+    }
+
+    for(unsigned int i = 0; i < particles.flags.size(); ++i)
+    {
+        particles.SetFlag(i, ParticleData::SLEEPING, false);
+        particles.collisions[i]->SetAsleep(false);
+    }
+}
+
+void SleepTracker::Update(ParticleData& particles, const std::vector<D3DXVECTOR3>& previousState)
+{
+    std::fill(m_movement.begin(), m_movement.end(), 0.0f);
+    for(unsigned int i = 0; i < m_tiles.size(); ++i)
+    {
+        const int tile = m_tiles[i];
+        const D3DXVECTOR3 movement(particles.positions[i] - previousState[i]);
+        m_movement[tile] = max(m_movement[tile], D3DXVec3LengthSq(&movement));
+    }
+
+    const float sleepDistanceSqr = SLEEP_DISTANCE * SLEEP_DISTANCE;
+    for(int tile = 0; tile < static_cast<int>(m_asleep.size()); ++tile)
+    {
+        // A tile stays awake while any neighbouring tile is
+        // moving as the springs will soon pull it along
+        bool moving = false;
+        for(int i = m_neighbourStart[tile]; i < m_neighbourStart[tile+1] && !moving; ++i)
+        {
+            moving = m_movement[m_neighbours[i]] > sleepDistanceSqr;
+        }
+
+        if(moving)
+        {
+            m_restingTicks[tile] = 0;
+            if(m_asleep[tile])
+            {
+                SetAsleep(particles, tile, false);
+            }
+        }
+        else if(!m_asleep[tile] && ++m_restingTicks[tile] >= SLEEP_TICKS)
+        {
+            SetAsleep(particles, tile, true);
+        }
+    }
+}
+
+void SleepTracker::WakeParticle(ParticleData& particles, int index)
+{
+    const int tile = m_tiles[index];
+    m_restingTicks[tile] = 0;
+    if(m_asleep[tile])
+    {
+        SetAsleep(particles, tile, false);
+    }
+}
+
+void SleepTracker::AddParticle(int index, int source)
+{
+    assert(index == static_cast<int>(m_tiles.size()));
+    const int tile = m_tiles[source];
+    m_tiles.push_back(tile);
+    m_tileParticles[tile].push_back(index);
+}
+
+void SleepTracker::WakeAll(ParticleData& particles)
+{
+    std::fill(m_restingTicks.begin(), m_restingTicks.end(), 0);
+    for(unsigned int tile = 0; tile < m_asleep.size() && m_sleepingTiles > 0; ++tile)
+    {
+        if(m_asleep[tile])
+        {
+            SetAsleep(particles, tile, false);
+        }
+    }
+}
+
+void SleepTracker::SetAsleep(ParticleData& particles, int tile, bool asleep)
+{
+    m_asleep[tile] = asleep ? 1 : 0;
+    m_sleepingTiles += asleep ? 1 : -1;
+
+    for(int index : m_tileParticles[tile])
+    {
+        particles.collisions[index]->SetAsleep(asleep);
+        if(asleep)
+        {
+            // Remove any velocity left over so the tile wakes from rest
+            particles.SetFlag(index, ParticleData::SLEEPING, true);
+            particles.previousPositions[index] = particles.positions[index];
+            MakeZeroVector(particles.accelerations[index]);
+        }
+        else
+        {
+            particles.SetFlag(index, ParticleData::SLEEPING, false);
+        }
+    }
+}
@@ -0,0 +1,116 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - sleeptracker.h
+////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include "common.h"
+
+struct ParticleData;
+class SpringBuffer;
+
+/**
+* Tracks tiles of the cloth that have come to rest.
+* A tile falls asleep once none of its particles have moved more than a
+* threshold for a number of ticks; its particles are then flagged as sleeping
+* and skipped by integration, the springs and the collision broadphase
+* until the tile or one of its neighbours moves again.
+*/
+class SleepTracker
+{
+public:
+
+    /**
+    * Constructor
+    */
+    SleepTracker();
+
+    /**
+    * Splits the cloth grid into square tiles and wakes all particles
+    * @param particles The particle data of the cloth grid
+    * @param rows The number of particles in a row/column
+    */
+    void Initialise(ParticleData& particles, int rows);
+
+    /**
+    * Splits the cloth into tiles of consecutive particles and wakes all 
+    * particles; tiles joined by a spring are neighbours of each other
+    * @param particles The particle data ordered so neighbours are close
+    * @param springs The springs connecting the particles
+    */
+    void Initialise(ParticleData& particles, const SpringBuffer& springs);
+
+    /**
+    * Updates the tiles from the movement of the particles over the last tick
+    * @param particles The particle data of the cloth
+    * @param previousState The particle positions at the start of the tick
+    */
+    void Update(ParticleData& particles, const std::vector<D3DXVECTOR3>& previousState);
+
+    /**
+    * Wakes the tile holding the particle
+    * @param particles The particle data of the cloth
+    * @param index The index of the particle
+    */
+    void WakeParticle(ParticleData& particles, int index);
+
+    /**
+    * Adds a particle to the same tile as another particle
+    * @param index The index of the new particle which must follow the last
+    * @param source The index of the particle whose tile to join
+    */
+    void AddParticle(int index, int source);
+
+    /**
+    * Wakes all tiles of the cloth
+    * @param particles The particle data of the cloth
+    */
+    void WakeAll(ParticleData& particles);
+
+    /**
+    * @return whether every tile of the cloth is asleep
+    */
+    bool IsAsleep() const;
+
+    /**
+    * @return the number of tiles currently asleep
+    */
+    int GetSleepingTiles() const;
+
+    /**
+    * @return the number of tiles the cloth is split into
+    */
+    int GetTileCount() const;
+
+private:
+
+    /**
+    * Groups the particles by tile and resets the state of each tile
+    * @param particles The particle data of the cloth
+    * @param neighbours The tiles that keep each tile awake
+    */
+    void CreateTiles(ParticleData& particles, 
+        const std::vector<std::vector<int>>& neighbours);
+
+    /**
+    * Sets whether all particles in the tile are asleep
+    * @param particles The particle data of the cloth
+    * @param tile The index of the tile
+    * @param asleep Whether the tile is asleep
+    */
+    void SetAsleep(ParticleData& particles, int tile, bool asleep);
+
+    /**
+    * Prevent copying
+    */
+    SleepTracker(const SleepTracker&);
+    SleepTracker& operator=(const SleepTracker&);
+
+    int m_sleepingTiles;                  ///< Number of tiles currently asleep
+    std::vector<int> m_tiles;             ///< Tile each particle belongs to
+    std::vector<std::vector<int>> m_tileParticles; ///< Particle indices of each tile
+    std::vector<int> m_neighbourStart;    ///< Offset into the neighbours for each tile
+    std::vector<int> m_neighbours;        ///< Tiles that keep each tile awake including itself
+    std::vector<float> m_movement;        ///< Largest squared movement of a particle in each tile
+    std::vector<int> m_restingTicks;      ///< Ticks each tile has been at rest
+    std::vector<unsigned char> m_asleep;  ///< Whether each tile is asleep
+};
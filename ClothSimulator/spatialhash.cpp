@@ -0,0 +1,98 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - spatialhash.cpp
+////////////////////////////////////////////////////////////////////////////////////////
+
+#include "spatialhash.h"
+#include <algorithm>
+#include <assert.h>
+
+namespace
+{
+    const int NEIGHBOUR_CELLS = 27;  ///< Number of cells searched around a point
+    const int TABLE_SCALE = 2;       ///< Buckets allocated for each point inserted
+}
+
+SpatialHash::SpatialHash() :
+    m_cellSize(1.0f)
+{
+}
+
+int SpatialHash::GetCell(float value) const
+{
+    return static_cast<int>(std::floor(value / m_cellSize));
+}
+
+unsigned int SpatialHash::GetBucket(int x, int y, int z) const
+{
+    // Large primes from 'Optimized Spatial Hashing for
+    // Collision Detection of Deformable Objects' by Teschner et al.
+    const unsigned int hash = (static_cast<unsigned int>(x) * 73856093u) ^
+        (static_cast<unsigned int>(y) * 19349663u) ^
+        (static_cast<unsigned int>(z) * 83492791u);
+
+    return hash % (m_bucketStart.size()-1);
+}
+
+void SpatialHash::Build(const std::vector<D3DXVECTOR3>& points, float cellSize)
+{
+    assert(cellSize > 0.0f);
+    m_cellSize = cellSize;
+
+    const int tableSize = max(static_cast<int>(points.size()) * TABLE_SCALE, 1);
+    m_bucketStart.assign(tableSize + 1, 0);
+    m_buckets.resize(points.size());
+    m_entries.resize(points.size());
+
+    // Count the points that fall into each bucket
+    for(unsigned int i = 0; i < points.size(); ++i)
+    {
+        m_buckets[i] = GetBucket(GetCell(points[i].x),
+            GetCell(points[i].y), GetCell(points[i].z));
+        ++m_bucketStart[m_buckets[i]];
+    }
+
+    // Convert the counts to the end offset of each bucket
+    for(unsigned int i = 1; i < m_bucketStart.size(); ++i)
+    {
+        m_bucketStart[i] += m_bucketStart[i-1];
+    }
+
+    // Fill the buckets backwards so each bucket's start offset is left behind
+    for(int i = static_cast<int>(points.size())-1; i >= 0; --i)
+    {
+        m_entries[--m_bucketStart[m_buckets[i]]] = i;
+    }
+}
+
+void SpatialHash::FindNeighbours(const D3DXVECTOR3& position,
+                                 std::vector<int>& neighbours) const
+{
+    neighbours.clear();
+
+    const int cellX = GetCell(position.x);
+    const int cellY = GetCell(position.y);
+    const int cellZ = GetCell(position.z);
+
+    // Multiple cells can share a bucket; only search each bucket once
+    unsigned int searched[NEIGHBOUR_CELLS];
+    int searchedCount = 0;
+
+    for(int x = cellX-1; x <= cellX+1; ++x)
+    {
+        for(int y = cellY-1; y <= cellY+1; ++y)
+        {
+            for(int z = cellZ-1; z <= cellZ+1; ++z)
+            {
+                const unsigned int bucket = GetBucket(x, y, z);
+                if(std::find(searched, searched + searchedCount, bucket)
+                    == searched + searchedCount)
+                {
+                    searched[searchedCount++] = bucket;
+                    neighbours.insert(neighbours.end(),
+                        m_entries.begin() + m_bucketStart[bucket],
+                        m_entries.begin() + m_bucketStart[bucket+1]);
+                }
+            }
+        }
+    }
+}
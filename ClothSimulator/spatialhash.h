@@ -0,0 +1,61 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - spatialhash.h
+////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include "common.h"
+
+/**
+* Uniform grid spatial hash for fast neighbour queries between points.
+* Points are bucketed by a counting sort so the hash is rebuilt in linear time.
+*/
+class SpatialHash
+{
+public:
+
+    /**
+    * Constructor
+    */
+    SpatialHash();
+
+    /**
+    * Rebuilds the hash with the given points
+    * @param points The points in world coordinates to insert
+    * @param cellSize The width of a single grid cell
+    */
+    void Build(const std::vector<D3DXVECTOR3>& points, float cellSize);
+
+    /**
+    * Finds all points that exist within the cell of the given
+    * position and the 26 cells that surround it
+    * @param position The position in world coordinates to search around
+    * @param neighbours Filled with the indices of any points found
+    * @note may return points outside the neighbouring cells due to hash collisions
+    */
+    void FindNeighbours(const D3DXVECTOR3& position, std::vector<int>& neighbours) const;
+
+private:
+
+    /**
+    * @param x/y/z The grid coordinates of the cell
+    * @return the bucket the cell maps to in the table
+    */
+    unsigned int GetBucket(int x, int y, int z) const;
+
+    /**
+    * @param value The world coordinate component
+    * @return the grid coordinate component the value is inside
+    */
+    int GetCell(float value) const;
+
+    /**
+    * Prevent copying
+    */
+    SpatialHash(const SpatialHash&);
+    SpatialHash& operator=(const SpatialHash&);
+
+    float m_cellSize;                         ///< Width of a single grid cell
+    std::vector<unsigned int> m_buckets;      ///< Bucket each point was inserted into
+    std::vector<unsigned int> m_bucketStart;  ///< Offset into the entries for each bucket
+    std::vector<int> m_entries;               ///< Point indices sorted by bucket
+};
@@ -4,17 +4,17 @@
 
 #pragma once
 #include "common.h"
+#include "springkernel.h"
 
-class Particle;
+struct ParticleData;
 class Diagnostic;
+class ThreadPool;
 
 /**
-* Spring between particles for the cloth
+* Spring between two particles of the cloth
 */
-class Spring
+struct Spring
 {
-public:
-
     /**
     * Types of springs available
     */
@@ -22,40 +22,217 @@ public:
     {
         STRETCH,
         SHEAR,
-        BEND
+        BEND,
+        MAX_TYPES
     };
 
+    unsigned int particle1;  ///< Index of the first connected particle
+    unsigned int particle2;  ///< Index of the second connected particle
+    float restDistance;      ///< distance for spring at rest
+};
+
+/**
+* Packed buffer of all springs for the cloth solved in a single pass
+*/
+class SpringBuffer
+{
+public:
+
     /**
     * Constructor
     */
-    Spring();
+    SpringBuffer();
+
+    /**
+    * Removes all springs from the buffer
+    * @param reserve The number of springs expected to be added
+    */
+    void Clear(int reserve);
+
+    /**
+    * Adds a spring between two particles at their current distance
+    * @param particles The particle data the springs connect
+    * @param p1/p2 The index of the two particles connected by the spring
+    * @param type The type of spring created
+    */
+    void AddSpring(const ParticleData& particles, int p1, int p2, Spring::Type type);
 
     /**
-    * Creates the spring
-    * @param p1/p2 The two particles connected by the spring
-    * @param id The ID of the particle
+    * Adds a spring between two particles with a set rest distance
+    * @param p1/p2 The index of the two particles connected by the spring
+    * @param restDistance The distance between the particles at rest
     * @param type The type of spring created
     */
-    void Initialise(Particle& p1, Particle& p2, int id, Type type);
+    void AddSpring(int p1, int p2, float restDistance, Spring::Type type);
+
+    /**
+    * Orders the springs by the particles they connect for memory locality
+    * then groups them into colours where no two springs share a particle
+    * @param particleCount The number of particles the springs connect
+    */
+    void SortSprings(int particleCount);
+
+    /**
+    * Moves the connected particles towards the spring rest distance
+    * @param particles The particle data the springs connect
+    */
+    void SolveSprings(ParticleData& particles) const;
+
+    /**
+    * Moves the connected particles towards the spring rest distance
+    * with each colour of springs split across the thread pool
+    * @param particles The particle data the springs connect
+    * @param pool The threads to solve with
+    */
+    void SolveSprings(ParticleData& particles, ThreadPool& pool) const;
+
+    /**
+    * Moves the connected particles together only where the spring is
+    * longer than its rest distance with each colour split across the thread pool
+    * @param particles The particle data the springs connect
+    * @param pool The threads to solve with
+    */
+    void SolveStretching(ParticleData& particles, ThreadPool& pool) const;
+
+    /**
+    * Solves the springs as compliant constraints for a single substep
+    * with each colour of springs split across the thread pool
+    * @param particles The particle data the springs connect
+    * @param pool The threads to solve with
+    * @param substep The fraction of the tick each substep covers
+    */
+    void SolveConstraints(ParticleData& particles, ThreadPool& pool, float substep);
+
+    /**
+    * Measures how far the springs are from their rest distance
+    * @param particles The particle data the springs connect
+    * @param pool The threads to measure with
+    * @param rmsError Set to the root mean square error relative to the rest distance
+    * @return the largest error of any spring relative to its rest distance
+    */
+    float MeasureError(const ParticleData& particles, ThreadPool& pool, float& rmsError) const;
+
+    /**
+    * Finds the springs stretched beyond the limit for their type
+    * @param particles The particle data the springs connect
+    * @param limits The length relative to the rest distance each type of spring breaks at
+    * @param springs Filled with the index of each overstretched spring
+    */
+    void FindOverstretched(const ParticleData& particles, 
+        const float* limits, std::vector<int>& springs) const;
+
+    /**
+    * Removes a spring keeping each colour packed by moving 
+    * at most one spring of each later colour into the gap
+    * @param index The index of the spring to remove
+    * @note only springs after the index are moved
+    */
+    void RemoveSpring(int index);
 
     /**
-    * Update the spring
-    * @param timestep multiplier solved spring positions
+    * Moves one end of a spring to another particle. The colours stay valid 
+    * as long as the new particle only takes springs from the old one.
+    * @param index The index of the spring
+    * @param from The particle to move the end of the spring from
+    * @param to The particle to move the end of the spring to
     */
-    void SolveSpring(float timestep);
+    void ReplaceParticle(int index, int from, int to);
 
     /**
-    * Updates the line diagnostic for the spring
+    * Adds a particle not connected to any springs
+    */
+    void AddParticle();
+
+    /**
+    * @param particle The index of the particle
+    * @return the index of each spring connected to the particle
+    */
+    const std::vector<int>& GetParticleSprings(int particle) const;
+
+    /**
+    * Sets how much a type of spring gives under load when solved as a constraint
+    * @param type The type of spring to set
+    * @param compliance The inverse stiffness where zero is infinitely stiff
+    */
+    void SetCompliance(Spring::Type type, float compliance);
+
+    /**
+    * Updates the line diagnostic for the springs
     * @param diagnostic The diagnostic renderer
+    * @param particles The particle data the springs connect
+    */
+    void UpdateDiagnostics(Diagnostic& diagnostic, const ParticleData& particles) const;
+
+    /**
+    * @return the number of springs in the buffer
+    */
+    int GetCount() const;
+
+    /**
+    * @param index The index of the spring in the buffer
+    * @return the spring at the index
     */
-    void UpdateDiagnostic(Diagnostic& diagnostic) const;
+    const Spring& GetSpring(int index) const;
+
+    /**
+    * @param index The index of the spring in the buffer
+    * @return the type of the spring at the index
+    */
+    Spring::Type GetType(int index) const;
+
+    /**
+    * @return the number of independent spring colours
+    */
+    int GetColourCount() const;
+
+    /**
+    * @return the name of the instruction set used to solve the springs
+    */
+    std::string GetInstructionSetName() const;
 
 private:
 
-    Type m_type;            ///< type of spring
-    int m_id;               ///< ID for the spring
-    int m_color;            ///< Color of spring depending on how it affects the cloth
-    Particle* m_particle1;  ///< connected particle
-    Particle* m_particle2;  ///< connected particle
-    float m_restDistance;   ///< distance for spring at rest
+    /**
+    * Moves the connected particles towards the spring rest distance
+    * @param particles The particle data the springs connect
+    * @param begin/end The range of springs to solve
+    */
+    void SolveSprings(ParticleData& particles, int begin, int end) const;
+
+    /**
+    * Moves the connected particles together where the spring is stretched
+    * @param particles The particle data the springs connect
+    * @param begin/end The range of springs to solve
+    */
+    void SolveStretching(ParticleData& particles, int begin, int end) const;
+
+    /**
+    * Solves the springs as compliant constraints
+    * @param particles The particle data the springs connect
+    * @param compliance The compliance for each spring type scaled by the substep
+    * @param begin/end The range of springs to solve
+    */
+    void SolveConstraints(ParticleData& particles, 
+        const float* compliance, int begin, int end);
+
+    /**
+    * Rearranges the springs into the given order
+    * @param order The index of the spring to place at each position
+    */
+    void ReorderSprings(const std::vector<int>& order);
+
+    /**
+    * Copies a spring over another updating the springs of its particles
+    * @param from The index of the spring to copy
+    * @param to The index of the spring to overwrite
+    */
+    void MoveSpring(int from, int to);
+
+    std::vector<Spring> m_springs;      ///< Data required for solving each spring
+    std::vector<unsigned char> m_types; ///< Type of each spring
+    std::vector<int> m_colourStart;     ///< Offset of the first spring for each colour
+    std::vector<float> m_multipliers;   ///< Lagrange multiplier for each spring when solved as a constraint
+    std::vector<std::vector<int>> m_particleSprings; ///< Springs connected to each particle
+    float m_compliance[Spring::MAX_TYPES]; ///< Inverse stiffness for each type of spring
+    SpringKernel m_kernel;              ///< Solver for a range of springs of one colour
 };
@@ -0,0 +1,389 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - springkernel.cpp
+////////////////////////////////////////////////////////////////////////////////////////
+
+#include "springkernel.h"
+#include "spring.h"
+#include "particle.h"
+#include <intrin.h>
+#include <immintrin.h>
+
+namespace
+{
+    const float EQUAL_WEIGHT = 0.5f;     ///< Amount each particle moves without interaction
+    const float SMALL_WEIGHT = 0.1f;     ///< Amount the particle with most interaction moves
+    const float LARGE_WEIGHT = 0.9f;     ///< Amount the particle with least interaction moves
+
+    /**
+    * @return whether the processor and operating system support AVX2
+    */
+    bool SupportsAVX2()
+    {
+        int info[4];
+        __cpuid(info, 0);
+        if(info[0] < 7)
+        {
+            return false;
+        }
+
+        // Require the OS to save the YMM registers on a context switch
+        __cpuid(info, 1);
+        const bool osxsave = (info[2] & (1 << 27)) != 0;
+        const bool avx = (info[2] & (1 << 28)) != 0;
+        if(!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6)
+        {
+            return false;
+        }
+
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+    }
+
+    /**
+    * @return whether the processor supports SSE2
+    */
+    bool SupportsSSE2()
+    {
+        int info[4];
+        __cpuid(info, 1);
+        return (info[3] & (1 << 26)) != 0;
+    }
+
+    /**
+    * Chooses between two values for each component of a vector
+    * @param mask Whether to choose the first value for each component
+    */
+    inline __m128 Select(__m128 mask, __m128 a, __m128 b)
+    {
+        return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+    }
+}
+
+SpringKernel::SpringKernel() :
+    m_instructionSet(SCALAR)
+{
+    if(SupportsAVX2())
+    {
+        m_instructionSet = AVX2;
+    }
+    else if(SupportsSSE2())
+    {
+        m_instructionSet = SSE2;
+    }
+}
+
+std::string SpringKernel::GetInstructionSetName() const
+{
+    switch(m_instructionSet)
+    {
+    case AVX2:
+        return "AVX2";
+    case SSE2:
+        return "SSE2";
+    default:
+        return "Scalar";
+    }
+}
+
+void SpringKernel::Solve(const Spring* springs, int count, ParticleData& particles) const
+{
+    switch(m_instructionSet)
+    {
+    case AVX2:
+        SolveAVX2(springs, count, particles);
+        break;
+    case SSE2:
+        SolveSSE2(springs, count, particles);
+        break;
+    default:
+        SolveScalar(springs, count, particles);
+        break;
+    }
+}
+
+void SpringKernel::SolveScalar(const Spring* springs, int count, ParticleData& particles)
+{
+    D3DXVECTOR3* positions = &particles.positions[0];
+    const D3DXVECTOR3* velocities = &particles.interactingVelocities[0];
+    const float* inverseMasses = &particles.inverseMasses[0];
+
+    for(int i = 0; i < count; ++i)
+    {
+        const unsigned int p1 = springs[i].particle1;
+        const unsigned int p2 = springs[i].particle2;
+        const D3DXVECTOR3& v1 = velocities[p1];
+        const D3DXVECTOR3& v2 = velocities[p2];
+
+        D3DXVECTOR3 difference(positions[p2] - positions[p1]);
+        float distance = D3DXVec3Length(&difference);
+        D3DXVECTOR3 error(difference-((difference/distance)*springs[i].restDistance)); 
+
+        float weight1 = EQUAL_WEIGHT;
+        float weight2 = EQUAL_WEIGHT;
+        if(v1 != v2 && (!IsZeroVector(v1) || !IsZeroVector(v2)))
+        {
+            // Move the particle with the smallest amount of interacting 
+            // velocity towards the particle with the most amount
+            const bool v1Larger = D3DXVec3LengthSq(&v1) > D3DXVec3LengthSq(&v2);
+            weight1 = v1Larger ? SMALL_WEIGHT : LARGE_WEIGHT;
+            weight2 = v1Larger ? LARGE_WEIGHT : SMALL_WEIGHT;
+        }
+
+        // Share the correction by inverse mass so pinned or sleeping particles stay put
+        weight1 *= inverseMasses[p1];
+        weight2 *= inverseMasses[p2];
+        const float share = 1.0f / max(weight1 + weight2, FLT_MIN);
+
+        positions[p1] += error * (weight1 * share);
+        positions[p2] -= error * (weight2 * share);
+    }
+}
+
+void SpringKernel::SolveSSE2(const Spring* springs, int count, ParticleData& particles)
+{
+    D3DXVECTOR3* positions = &particles.positions[0];
+    const D3DXVECTOR3* velocities = &particles.interactingVelocities[0];
+    const float* inverseMasses = &particles.inverseMasses[0];
+
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 minimum = _mm_set1_ps(FLT_MIN);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 threeHalves = _mm_set1_ps(1.5f);
+    const __m128 equalWeight = _mm_set1_ps(EQUAL_WEIGHT);
+    const __m128 smallWeight = _mm_set1_ps(SMALL_WEIGHT);
+    const __m128 largeWeight = _mm_set1_ps(LARGE_WEIGHT);
+
+    const int vectorCount = count - (count % 4);
+    for(int i = 0; i < vectorCount; i += 4)
+    {
+        // SSE2 has no gather so transpose the four springs into registers
+        unsigned int p1[4], p2[4];
+        alignas(16) float data[15][4];
+        for(int lane = 0; lane < 4; ++lane)
+        {
+            const Spring& spring = springs[i+lane];
+            p1[lane] = spring.particle1;
+            p2[lane] = spring.particle2;
+
+            const D3DXVECTOR3& position1 = positions[p1[lane]];
+            const D3DXVECTOR3& position2 = positions[p2[lane]];
+            const D3DXVECTOR3& velocity1 = velocities[p1[lane]];
+            const D3DXVECTOR3& velocity2 = velocities[p2[lane]];
+
+            data[0][lane] = position1.x;
+            data[1][lane] = position1.y;
+            data[2][lane] = position1.z;
+            data[3][lane] = position2.x;
+            data[4][lane] = position2.y;
+            data[5][lane] = position2.z;
+            data[6][lane] = velocity1.x;
+            data[7][lane] = velocity1.y;
+            data[8][lane] = velocity1.z;
+            data[9][lane] = velocity2.x;
+            data[10][lane] = velocity2.y;
+            data[11][lane] = velocity2.z;
+            data[12][lane] = spring.restDistance;
+            data[13][lane] = inverseMasses[p1[lane]];
+            data[14][lane] = inverseMasses[p2[lane]];
+        }
+
+        __m128 x1 = _mm_load_ps(data[0]);
+        __m128 y1 = _mm_load_ps(data[1]);
+        __m128 z1 = _mm_load_ps(data[2]);
+        __m128 x2 = _mm_load_ps(data[3]);
+        __m128 y2 = _mm_load_ps(data[4]);
+        __m128 z2 = _mm_load_ps(data[5]);
+        const __m128 vx1 = _mm_load_ps(data[6]);
+        const __m128 vy1 = _mm_load_ps(data[7]);
+        const __m128 vz1 = _mm_load_ps(data[8]);
+        const __m128 vx2 = _mm_load_ps(data[9]);
+        const __m128 vy2 = _mm_load_ps(data[10]);
+        const __m128 vz2 = _mm_load_ps(data[11]);
+        const __m128 rest = _mm_load_ps(data[12]);
+        const __m128 w1 = _mm_load_ps(data[13]);
+        const __m128 w2 = _mm_load_ps(data[14]);
+
+        const __m128 dx = _mm_sub_ps(x2, x1);
+        const __m128 dy = _mm_sub_ps(y2, y1);
+        const __m128 dz = _mm_sub_ps(z2, z1);
+        const __m128 lengthSqr = _mm_add_ps(_mm_add_ps(
+            _mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+
+        // Approximate 1/distance refined with a Newton-Raphson step
+        __m128 inverse = _mm_rsqrt_ps(lengthSqr);
+        inverse = _mm_mul_ps(inverse, _mm_sub_ps(threeHalves, _mm_mul_ps(
+            _mm_mul_ps(half, lengthSqr), _mm_mul_ps(inverse, inverse))));
+
+        // error = difference - (difference/distance)*rest
+        const __m128 scale = _mm_sub_ps(one, _mm_mul_ps(rest, inverse));
+        const __m128 ex = _mm_mul_ps(dx, scale);
+        const __m128 ey = _mm_mul_ps(dy, scale);
+        const __m128 ez = _mm_mul_ps(dz, scale);
+
+        // Move the particle with the smallest amount of interacting 
+        // velocity towards the particle with the most amount
+        const __m128 different = _mm_or_ps(_mm_or_ps(_mm_cmpneq_ps(vx1, vx2), 
+            _mm_cmpneq_ps(vy1, vy2)), _mm_cmpneq_ps(vz1, vz2));
+        const __m128 moving = _mm_or_ps(
+            _mm_or_ps(_mm_or_ps(_mm_cmpneq_ps(vx1, zero), _mm_cmpneq_ps(vy1, zero)), 
+            _mm_cmpneq_ps(vz1, zero)),
+            _mm_or_ps(_mm_or_ps(_mm_cmpneq_ps(vx2, zero), _mm_cmpneq_ps(vy2, zero)), 
+            _mm_cmpneq_ps(vz2, zero)));
+        const __m128 interacting = _mm_and_ps(different, moving);
+
+        const __m128 speed1 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx1, vx1), 
+            _mm_mul_ps(vy1, vy1)), _mm_mul_ps(vz1, vz1));
+        const __m128 speed2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx2, vx2), 
+            _mm_mul_ps(vy2, vy2)), _mm_mul_ps(vz2, vz2));
+        const __m128 v1Larger = _mm_cmpgt_ps(speed1, speed2);
+
+        __m128 weight1 = Select(interacting, 
+            Select(v1Larger, smallWeight, largeWeight), equalWeight);
+        __m128 weight2 = Select(interacting,
+            Select(v1Larger, largeWeight, smallWeight), equalWeight);
+
+        // Share the correction by inverse mass so pinned or sleeping particles stay put
+        weight1 = _mm_mul_ps(weight1, w1);
+        weight2 = _mm_mul_ps(weight2, w2);
+        const __m128 share = _mm_div_ps(one, _mm_max_ps(_mm_add_ps(weight1, weight2), minimum));
+        weight1 = _mm_mul_ps(weight1, share);
+        weight2 = _mm_mul_ps(weight2, share);
+
+        _mm_store_ps(data[0], _mm_add_ps(x1, _mm_mul_ps(ex, weight1)));
+        _mm_store_ps(data[1], _mm_add_ps(y1, _mm_mul_ps(ey, weight1)));
+        _mm_store_ps(data[2], _mm_add_ps(z1, _mm_mul_ps(ez, weight1)));
+        _mm_store_ps(data[3], _mm_sub_ps(x2, _mm_mul_ps(ex, weight2)));
+        _mm_store_ps(data[4], _mm_sub_ps(y2, _mm_mul_ps(ey, weight2)));
+        _mm_store_ps(data[5], _mm_sub_ps(z2, _mm_mul_ps(ez, weight2)));
+
+        for(int lane = 0; lane < 4; ++lane)
+        {
+            positions[p1[lane]] = D3DXVECTOR3(data[0][lane], data[1][lane], data[2][lane]);
+            positions[p2[lane]] = D3DXVECTOR3(data[3][lane], data[4][lane], data[5][lane]);
+        }
+    }
+
+    SolveScalar(springs + vectorCount, count - vectorCount, particles);
+}
+
+void SpringKernel::SolveAVX2(const Spring* springs, int count, ParticleData& particles)
+{
+    float* positions = &particles.positions[0].x;
+    const float* velocities = &particles.interactingVelocities[0].x;
+    const float* inverseMasses = &particles.inverseMasses[0];
+
+    static_assert(sizeof(Spring) == sizeof(int) * 3, "Spring must be tightly packed");
+    static_assert(sizeof(D3DXVECTOR3) == sizeof(float) * 3, "Vector must be tightly packed");
+
+    const __m256i springStride = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+    const __m256i vectorStride = _mm256_set1_epi32(3);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 minimum = _mm256_set1_ps(FLT_MIN);
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 threeHalves = _mm256_set1_ps(1.5f);
+    const __m256 equalWeight = _mm256_set1_ps(EQUAL_WEIGHT);
+    const __m256 smallWeight = _mm256_set1_ps(SMALL_WEIGHT);
+    const __m256 largeWeight = _mm256_set1_ps(LARGE_WEIGHT);
+
+    const int vectorCount = count - (count % 8);
+    for(int i = 0; i < vectorCount; i += 8)
+    {
+        // Gather the eight springs then the particle data they index
+        const int* spring = reinterpret_cast<const int*>(springs + i);
+        const __m256i p1 = _mm256_i32gather_epi32(spring, springStride, 4);
+        const __m256i p2 = _mm256_i32gather_epi32(spring + 1, springStride, 4);
+        const __m256 rest = _mm256_i32gather_ps(
+            reinterpret_cast<const float*>(spring + 2), springStride, 4);
+
+        const __m256i offset1 = _mm256_mullo_epi32(p1, vectorStride);
+        const __m256i offset2 = _mm256_mullo_epi32(p2, vectorStride);
+
+        const __m256 x1 = _mm256_i32gather_ps(positions, offset1, 4);
+        const __m256 y1 = _mm256_i32gather_ps(positions + 1, offset1, 4);
+        const __m256 z1 = _mm256_i32gather_ps(positions + 2, offset1, 4);
+        const __m256 x2 = _mm256_i32gather_ps(positions, offset2, 4);
+        const __m256 y2 = _mm256_i32gather_ps(positions + 1, offset2, 4);
+        const __m256 z2 = _mm256_i32gather_ps(positions + 2, offset2, 4);
+        const __m256 vx1 = _mm256_i32gather_ps(velocities, offset1, 4);
+        const __m256 vy1 = _mm256_i32gather_ps(velocities + 1, offset1, 4);
+        const __m256 vz1 = _mm256_i32gather_ps(velocities + 2, offset1, 4);
+        const __m256 vx2 = _mm256_i32gather_ps(velocities, offset2, 4);
+        const __m256 vy2 = _mm256_i32gather_ps(velocities + 1, offset2, 4);
+        const __m256 vz2 = _mm256_i32gather_ps(velocities + 2, offset2, 4);
+
+        const __m256 dx = _mm256_sub_ps(x2, x1);
+        const __m256 dy = _mm256_sub_ps(y2, y1);
+        const __m256 dz = _mm256_sub_ps(z2, z1);
+        const __m256 lengthSqr = _mm256_add_ps(_mm256_add_ps(
+            _mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+
+        // Approximate 1/distance refined with a Newton-Raphson step
+        __m256 inverse = _mm256_rsqrt_ps(lengthSqr);
+        inverse = _mm256_mul_ps(inverse, _mm256_sub_ps(threeHalves, _mm256_mul_ps(
+            _mm256_mul_ps(half, lengthSqr), _mm256_mul_ps(inverse, inverse))));
+
+        // error = difference - (difference/distance)*rest
+        const __m256 scale = _mm256_sub_ps(one, _mm256_mul_ps(rest, inverse));
+        const __m256 ex = _mm256_mul_ps(dx, scale);
+        const __m256 ey = _mm256_mul_ps(dy, scale);
+        const __m256 ez = _mm256_mul_ps(dz, scale);
+
+        // Move the particle with the smallest amount of interacting 
+        // velocity towards the particle with the most amount
+        const __m256 different = _mm256_or_ps(_mm256_or_ps(
+            _mm256_cmp_ps(vx1, vx2, _CMP_NEQ_UQ), _mm256_cmp_ps(vy1, vy2, _CMP_NEQ_UQ)),
+            _mm256_cmp_ps(vz1, vz2, _CMP_NEQ_UQ));
+        const __m256 moving = _mm256_or_ps(
+            _mm256_or_ps(_mm256_or_ps(_mm256_cmp_ps(vx1, zero, _CMP_NEQ_UQ), 
+            _mm256_cmp_ps(vy1, zero, _CMP_NEQ_UQ)), _mm256_cmp_ps(vz1, zero, _CMP_NEQ_UQ)),
+            _mm256_or_ps(_mm256_or_ps(_mm256_cmp_ps(vx2, zero, _CMP_NEQ_UQ), 
+            _mm256_cmp_ps(vy2, zero, _CMP_NEQ_UQ)), _mm256_cmp_ps(vz2, zero, _CMP_NEQ_UQ)));
+        const __m256 interacting = _mm256_and_ps(different, moving);
+
+        const __m256 speed1 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(vx1, vx1), 
+            _mm256_mul_ps(vy1, vy1)), _mm256_mul_ps(vz1, vz1));
+        const __m256 speed2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(vx2, vx2), 
+            _mm256_mul_ps(vy2, vy2)), _mm256_mul_ps(vz2, vz2));
+        const __m256 v1Larger = _mm256_cmp_ps(speed1, speed2, _CMP_GT_OQ);
+
+        __m256 weight1 = _mm256_blendv_ps(equalWeight, 
+            _mm256_blendv_ps(largeWeight, smallWeight, v1Larger), interacting);
+        __m256 weight2 = _mm256_blendv_ps(equalWeight, 
+            _mm256_blendv_ps(smallWeight, largeWeight, v1Larger), interacting);
+
+        // Share the correction by inverse mass so pinned or sleeping particles stay put
+        weight1 = _mm256_mul_ps(weight1, _mm256_i32gather_ps(inverseMasses, p1, 4));
+        weight2 = _mm256_mul_ps(weight2, _mm256_i32gather_ps(inverseMasses, p2, 4));
+        const __m256 share = _mm256_div_ps(one, 
+            _mm256_max_ps(_mm256_add_ps(weight1, weight2), minimum));
+        weight1 = _mm256_mul_ps(weight1, share);
+        weight2 = _mm256_mul_ps(weight2, share);
+
+        // AVX2 has no scatter; springs of a range share no particles
+        // so each lane can be written back without any conflicts
+        alignas(32) int index1[8], index2[8];
+        alignas(32) float result[6][8];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(index1), offset1);
+        _mm256_store_si256(reinterpret_cast<__m256i*>(index2), offset2);
+        _mm256_store_ps(result[0], _mm256_add_ps(x1, _mm256_mul_ps(ex, weight1)));
+        _mm256_store_ps(result[1], _mm256_add_ps(y1, _mm256_mul_ps(ey, weight1)));
+        _mm256_store_ps(result[2], _mm256_add_ps(z1, _mm256_mul_ps(ez, weight1)));
+        _mm256_store_ps(result[3], _mm256_sub_ps(x2, _mm256_mul_ps(ex, weight2)));
+        _mm256_store_ps(result[4], _mm256_sub_ps(y2, _mm256_mul_ps(ey, weight2)));
+        _mm256_store_ps(result[5], _mm256_sub_ps(z2, _mm256_mul_ps(ez, weight2)));
+
+        for(int lane = 0; lane < 8; ++lane)
+        {
+            positions[index1[lane]] = result[0][lane];
+            positions[index1[lane]+1] = result[1][lane];
+            positions[index1[lane]+2] = result[2][lane];
+            positions[index2[lane]] = result[3][lane];
+            positions[index2[lane]+1] = result[4][lane];
+            positions[index2[lane]+2] = result[5][lane];
+        }
+    }
+
+    SolveScalar(springs + vectorCount, count - vectorCount, particles);
+}
@@ -0,0 +1,66 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - springkernel.h
+////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include "common.h"
+
+struct Spring;
+struct ParticleData;
+
+/**
+* Solves ranges of springs that do not share any particles using
+* the widest instruction set supported by the processor
+*/
+class SpringKernel
+{
+public:
+
+    /**
+    * Instruction sets able to be used for solving
+    */
+    enum InstructionSet
+    {
+        SCALAR,
+        SSE2,
+        AVX2
+    };
+
+    /**
+    * Constructor; determines the instruction set to use
+    */
+    SpringKernel();
+
+    /**
+    * Moves the connected particles towards the spring rest distance
+    * @param springs The first spring of the range to solve
+    * @param count The number of springs in the range
+    * @param particles The particle data the springs connect
+    * @note springs in the range must not share any particles
+    */
+    void Solve(const Spring* springs, int count, ParticleData& particles) const;
+
+    /**
+    * @return the name of the instruction set used
+    */
+    std::string GetInstructionSetName() const;
+
+private:
+
+    /**
+    * Solves the range one spring at a time
+    */
+    static void SolveScalar(const Spring* springs, int count, ParticleData& particles);
+
+    /**
+    * Solves the range four springs at a time
+    */
+    static void SolveSSE2(const Spring* springs, int count, ParticleData& particles);
+
+    /**
+    * Solves the range eight springs at a time
+    */
+    static void SolveAVX2(const Spring* springs, int count, ParticleData& particles);
+
+    InstructionSet m_instructionSet; ///< Widest instruction set supported
+};
@@ -0,0 +1,159 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - threadpool.cpp
+////////////////////////////////////////////////////////////////////////////////////////
+
+#include "threadpool.h"
+#include <assert.h>
+
+ThreadPool::ThreadPool(int threads) :
+    m_owner(std::this_thread::get_id()),
+    m_job(nullptr),
+    m_jobCount(0),
+    m_jobChunks(0),
+    m_jobGrain(0),
+    m_jobThreads(0),
+    m_pending(0),
+    m_generation(0),
+    m_shutdown(false),
+    m_deterministic(false)
+{
+    if(threads <= 0)
+    {
+        threads = static_cast<int>(std::thread::hardware_concurrency());
+    }
+
+    for(int i = 1; i < threads; ++i)
+    {
+        m_workers.push_back(std::thread(&ThreadPool::WorkerLoop, this, i));
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_shutdown = true;
+    }
+    m_jobStarted.notify_all();
+
+    for(std::thread& worker : m_workers)
+    {
+        worker.join();
+    }
+}
+
+int ThreadPool::GetThreadCount() const
+{
+    return static_cast<int>(m_workers.size()) + 1;
+}
+
+void ThreadPool::SetDeterministic(bool deterministic)
+{
+    assert(!m_job);
+    m_deterministic = deterministic;
+}
+
+bool ThreadPool::IsDeterministic() const
+{
+    return m_deterministic;
+}
+
+void ThreadPool::RunChunks(int thread)
+{
+    // Chunks are dealt out in turn so which thread runs a chunk never depends on timing
+    for(int chunk = thread; chunk < m_jobChunks; chunk += m_jobThreads)
+    {
+        if(m_jobGrain > 0)
+        {
+            const int begin = chunk * m_jobGrain;
+            const int end = begin + m_jobGrain;
+            (*m_job)(begin, end < m_jobCount ? end : m_jobCount);
+        }
+        else
+        {
+            const int begin = static_cast<int>(
+                (static_cast<long long>(m_jobCount) * chunk) / m_jobChunks);
+            const int end = static_cast<int>(
+                (static_cast<long long>(m_jobCount) * (chunk + 1)) / m_jobChunks);
+
+            (*m_job)(begin, end);
+        }
+    }
+}
+
+void ThreadPool::ParallelFor(int count, int grainSize, const RangeFn& fn)
+{
+    const int grain = grainSize > 1 ? grainSize : 1;
+    const int chunks = (count + grain - 1) / grain;
+    const int threads = chunks < GetThreadCount() ? chunks : GetThreadCount();
+
+    // A job already set means this call is nested inside the owner's chunk
+    if(threads <= 1 || std::this_thread::get_id() != m_owner || m_job)
+    {
+        if(m_deterministic)
+        {
+            // Keep the same chunks as when split so results match any thread count
+            for(int begin = 0; begin < count; begin += grain)
+            {
+                fn(begin, begin + grain < count ? begin + grain : count);
+            }
+        }
+        else if(count > 0)
+        {
+            fn(0, count);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_job = &fn;
+        m_jobCount = count;
+        m_jobChunks = m_deterministic ? chunks : threads;
+        m_jobGrain = m_deterministic ? grain : 0;
+        m_jobThreads = threads;
+        m_pending = threads - 1;
+        ++m_generation;
+    }
+    m_jobStarted.notify_all();
+
+    // The owner always takes the first chunk
+    RunChunks(0);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_jobFinished.wait(lock, [this](){ return m_pending == 0; });
+    m_job = nullptr;
+}
+
+void ThreadPool::WorkerLoop(int worker)
+{
+    unsigned int generation = 0;
+    for(;;)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_jobStarted.wait(lock, [this, generation]()
+        { 
+            return m_shutdown || m_generation != generation; 
+        });
+
+        if(m_shutdown)
+        {
+            return;
+        }
+
+        generation = m_generation;
+        if(worker >= m_jobThreads)
+        {
+            continue;
+        }
+
+        lock.unlock();
+        RunChunks(worker);
+        lock.lock();
+
+        if(--m_pending == 0)
+        {
+            m_jobFinished.notify_one();
+        }
+    }
+}
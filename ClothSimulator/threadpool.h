@@ -0,0 +1,100 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - threadpool.h
+////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+/**
+* Fixed set of worker threads for splitting a loop across cores.
+* Work is divided into static contiguous chunks so the range each thread
+* processes only depends on the loop size and the number of threads.
+* When deterministic the chunks only depend on the loop size and grain
+* so results are identical for any number of threads.
+*/
+class ThreadPool
+{
+public:
+
+    typedef std::function<void(int begin, int end)> RangeFn;
+
+    /**
+    * Constructor
+    * @param threads The total threads to use including the 
+    *        calling thread or zero to use the available cores
+    */
+    explicit ThreadPool(int threads = 0);
+
+    /**
+    * Destructor
+    */
+    ~ThreadPool();
+
+    /**
+    * Calls the function over the range split between all threads
+    * and blocks until every chunk of the range has completed
+    * @param count The number of items in the range
+    * @param grainSize The minimum amount of items given to a thread
+    * @param fn The function to call for each chunk of the range
+    * @note calls made from a thread other than the owner or from 
+    *       inside another job run inline on the calling thread
+    */
+    void ParallelFor(int count, int grainSize, const RangeFn& fn);
+
+    /**
+    * @return the total threads used including the calling thread
+    */
+    int GetThreadCount() const;
+
+    /**
+    * Sets whether loops are split into grain sized chunks dealt to the 
+    * threads in turn rather than a single chunk for each thread
+    * @param deterministic Whether chunks are independent of the thread count
+    * @note only call while no job is running
+    */
+    void SetDeterministic(bool deterministic);
+
+    /**
+    * @return whether chunks are independent of the thread count
+    */
+    bool IsDeterministic() const;
+
+private:
+
+    /**
+    * Waits for and processes chunks of work until shutdown
+    * @param worker The chunk of each job given to this worker
+    */
+    void WorkerLoop(int worker);
+
+    /**
+    * Calls the job for every chunk given to the thread
+    * @param thread The index of the thread processing the chunks
+    */
+    void RunChunks(int thread);
+
+    /**
+    * Prevent copying
+    */
+    ThreadPool(const ThreadPool&);
+    ThreadPool& operator=(const ThreadPool&);
+
+    std::vector<std::thread> m_workers;        ///< Threads other than the owner
+    std::thread::id m_owner;                   ///< Thread allowed to distribute work
+    std::mutex m_mutex;                        ///< Guards the current job state
+    std::condition_variable m_jobStarted;      ///< Signals workers a new job is available
+    std::condition_variable m_jobFinished;     ///< Signals the owner all chunks are done
+    const RangeFn* m_job;                      ///< Function for the current job
+    int m_jobCount;                            ///< Number of items for the current job
+    int m_jobChunks;                           ///< Number of chunks for the current job
+    int m_jobGrain;                            ///< Items in each chunk when deterministic
+    int m_jobThreads;                          ///< Number of threads given chunks of the job
+    int m_pending;                             ///< Number of worker chunks still running
+    unsigned int m_generation;                 ///< Incremented for every new job
+    bool m_shutdown;                           ///< Whether workers should exit
+    bool m_deterministic;                      ///< Whether chunks are independent of the thread count
+};
@@ -10,6 +10,9 @@ namespace
     const double DT_INCREASE = 0.001; ///< Amount to change the forced deltatime
     const double DT_MAXIMUM = 0.03;   ///< Maximum allowed deltatime
     const double DT_MINIMUM = 0.01;   ///< Minimum allowed deltatime
+    const double PHYSICS_STEP = 1.0 / 60.0; ///< Default time for a single physics step
+    const int MAX_PHYSICS_STEPS = 4;        ///< Default maximum physics steps each frame
+    const double PHYSICS_RATES[] = { 30.0, 60.0, 120.0 }; ///< Physics steps each second to cycle between
 }
 
 Timer::Timer(EnginePtr engine) :
@@ -21,7 +24,11 @@ Timer::Timer(EnginePtr engine) :
     m_fpsCounter(0),
     m_engine(engine),
     m_forceDeltatime(false),
-    m_forcedDeltatime(0.04)
+    m_forcedDeltatime(0.04),
+    m_physicsStep(PHYSICS_STEP),
+    m_maxPhysicsSteps(MAX_PHYSICS_STEPS),
+    m_physicsSteps(0),
+    m_accumulatedTime(0.0)
 {
 }
 
@@ -52,6 +59,13 @@ void Timer::UpdateTimer()
     m_deltaTime = max(deltatime, DT_MINIMUM);
     m_deltaTime = min(m_deltaTime, DT_MAXIMUM);
 
+    // Physics runs at a fixed step using the real time passed rather than the 
+    // clamped deltatime; any time beyond the maximum steps is dropped so a
+    // slow frame cannot cause more steps next frame and fall further behind
+    m_accumulatedTime += m_forceDeltatime ? m_forcedDeltatime : deltatime;
+    m_physicsSteps = min(static_cast<int>(m_accumulatedTime / m_physicsStep), m_maxPhysicsSteps);
+    m_accumulatedTime = fmod(m_accumulatedTime, m_physicsStep);
+
     if(m_engine->diagnostic()->AllowDiagnostics(Diagnostic::TEXT))
     {
         m_engine->diagnostic()->UpdateText(Diagnostic::TEXT,
@@ -63,6 +77,12 @@ void Timer::UpdateTimer()
         m_engine->diagnostic()->UpdateText(Diagnostic::TEXT,
             "CappedDeltaTime", Diagnostic::WHITE, StringCast(m_deltaTime));
 
+        m_engine->diagnostic()->UpdateText(Diagnostic::TEXT,
+            "PhysicsSteps", Diagnostic::WHITE, StringCast(m_physicsSteps));
+
+        m_engine->diagnostic()->UpdateText(Diagnostic::TEXT,
+            "PhysicsStep", Diagnostic::WHITE, StringCast(m_physicsStep));
+
         if(m_forceDeltatime)
         {
             m_engine->diagnostic()->UpdateText(Diagnostic::TEXT,
@@ -80,6 +100,47 @@ float Timer::GetDeltaTime() const
     return static_cast<float>(m_forceDeltatime ? m_forcedDeltatime : m_deltaTime); 
 }
 
+void Timer::SetPhysicsStep(double step, int maxSteps)
+{
+    m_physicsStep = step;
+    m_maxPhysicsSteps = maxSteps;
+    m_accumulatedTime = 0.0;
+}
+
+void Timer::ChangePhysicsRate()
+{
+    // Move to the next faster rate, wrapping back to the slowest, while keeping
+    // the most time simulated each frame the same as the default step and steps
+    const double rate = 1.0 / m_physicsStep;
+    double next = PHYSICS_RATES[0];
+    for(double physicsRate : PHYSICS_RATES)
+    {
+        if(physicsRate > rate + 0.5)
+        {
+            next = physicsRate;
+            break;
+        }
+    }
+
+    const double step = 1.0 / next;
+    SetPhysicsStep(step, static_cast<int>((MAX_PHYSICS_STEPS * PHYSICS_STEP / step) + 0.5));
+}
+
+float Timer::GetPhysicsStep() const
+{
+    return static_cast<float>(m_physicsStep);
+}
+
+int Timer::GetPhysicsSteps() const
+{
+    return m_physicsSteps;
+}
+
+float Timer::GetInterpolation() const
+{
+    return static_cast<float>(m_accumulatedTime / m_physicsStep);
+}
+
 void Timer::ToggleForceDeltatime()
 {
     m_forceDeltatime = !m_forceDeltatime;
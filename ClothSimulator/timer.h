@@ -7,7 +7,9 @@
 #include "callbacks.h"
 
 /**
-* FPS class for determining frame rate and delta time
+* FPS class for determining frame rate and delta time.
+* Also accumulates the time passed to determine how many fixed
+* physics steps to run each frame independent of the frame rate.
 */
 class Timer
 {
@@ -33,6 +35,33 @@ public:
     */
     float GetDeltaTime() const;
 
+    /**
+    * Sets the fixed amount of time advanced each physics step
+    * @param step The time in seconds for a single step
+    * @param maxSteps The maximum number of steps to run each frame
+    */
+    void SetPhysicsStep(double step, int maxSteps);
+
+    /**
+    * Cycles the physics step between a set of rates
+    */
+    void ChangePhysicsRate();
+
+    /**
+    * @return The time in seconds for a single physics step
+    */
+    float GetPhysicsStep() const;
+
+    /**
+    * @return The number of physics steps to run this frame
+    */
+    int GetPhysicsSteps() const;
+
+    /**
+    * @return The amount of time left over as a fraction of a physics step
+    */
+    float GetInterpolation() const;
+
     /**
     * Toggles whether to use an explicitly set deltatime
     */
@@ -56,5 +85,9 @@ private:
     unsigned int m_fpsCounter;  ///< Amount of frames rendered since delta time counter began
     bool m_forceDeltatime;      ///< Whether to force deltatime explicitly or not
     double m_forcedDeltatime;   ///< The value for the forced deltatime
+    double m_physicsStep;       ///< The time in seconds for a single physics step
+    int m_maxPhysicsSteps;      ///< The maximum number of physics steps each frame
+    int m_physicsSteps;         ///< The number of physics steps to run this frame
+    double m_accumulatedTime;   ///< Time passed that has not yet been simulated
 };
 
@@ -0,0 +1,137 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - windfield.cpp
+////////////////////////////////////////////////////////////////////////////////////////
+
+#include "windfield.h"
+#include "particle.h"
+#include "threadpool.h"
+
+namespace
+{
+    const float AIR_DENSITY = 1.2f;           ///< Mass of air for each unit of volume
+    const float DRAG_COEFFICIENT = 0.5f;      ///< Amount of drag for air meeting the cloth face on
+    const float LIFT_COEFFICIENT = 0.2f;      ///< Amount of lift for air flowing across the cloth
+    const float GUST_AMOUNT = 0.4f;           ///< Fraction the average wind speed changes when gusting
+    const float GUST_FREQUENCY = 0.7f;        ///< Speed of the change between gusts
+    const float TURBULENCE_AMOUNT = 0.3f;     ///< Size of the turbulence relative to the wind speed
+    const float TURBULENCE_SCALE = 0.35f;     ///< Frequency of the turbulence across the scene
+    const D3DXVECTOR3 TURBULENCE_SPEED(1.3f, 1.7f, 2.1f); ///< Frequency of the turbulence over time
+    const int PARTICLE_GRAIN = 1024;          ///< Minimum particles given to a single thread
+    const int TRIANGLE_GRAIN = 1024;          ///< Minimum triangles given to a single thread
+}
+
+WindField::WindField() :
+    m_velocity(6.0f, 0.0f, 2.0f),
+    m_time(0.0f),
+    m_gust(1.0f)
+{
+}
+
+D3DXVECTOR3 WindField::GetVelocity(const D3DXVECTOR3& position) const
+{
+    // Waves moving through the scene in each axis give turbulence 
+    // that is smooth in space and time without storing a noise field
+    const float speed = D3DXVec3Length(&m_velocity);
+    const D3DXVECTOR3 turbulence(
+        std::sin(((position.y + position.z * 0.7f) * TURBULENCE_SCALE) + (m_time * TURBULENCE_SPEED.x)),
+        std::sin(((position.z + position.x * 0.6f) * TURBULENCE_SCALE) + (m_time * TURBULENCE_SPEED.y)),
+        std::sin(((position.x + position.y * 0.8f) * TURBULENCE_SCALE) + (m_time * TURBULENCE_SPEED.z)));
+
+    return (m_velocity * m_gust) + (turbulence * (speed * TURBULENCE_AMOUNT));
+}
+
+void WindField::SetVelocity(const D3DXVECTOR3& velocity)
+{
+    m_velocity = velocity;
+}
+
+void WindField::Apply(ParticleData& particles, 
+                      const std::vector<int>& triangles,
+                      const std::vector<std::vector<int>>& particleTriangles,
+                      ThreadPool& pool, 
+                      float deltatime, 
+                      float scale)
+{
+    // Tearing adds particles so the buffers follow the cloth rather than being built once
+    m_relative.resize(particleTriangles.size());
+    m_triangleForces.resize(triangles.size() / POINTS_IN_FACE);
+
+    m_time += deltatime;
+    m_gust = 1.0f + (GUST_AMOUNT * std::sin(m_time * GUST_FREQUENCY) * 
+        std::sin(m_time * GUST_FREQUENCY * 2.3f));
+
+    // Air relative to each particle is shared by all triangles around it
+    const float inverseDeltatime = deltatime > 0.0f ? 1.0f / deltatime : 0.0f;
+    pool.ParallelFor(static_cast<int>(m_relative.size()), PARTICLE_GRAIN,
+        [this, &particles, inverseDeltatime](int begin, int end)
+        {
+            for(int i = begin; i < end; ++i)
+            {
+                const D3DXVECTOR3& position = particles.positions[i];
+                m_relative[i] = GetVelocity(position) - 
+                    ((position - particles.previousPositions[i]) * inverseDeltatime);
+            }
+        });
+
+    // Find the force on each triangle split evenly between its particles
+    pool.ParallelFor(static_cast<int>(m_triangleForces.size()), TRIANGLE_GRAIN,
+        [this, &particles, &triangles](int begin, int end)
+        {
+            const float forceScale = 0.5f * AIR_DENSITY / static_cast<float>(POINTS_IN_FACE);
+            for(int i = begin; i < end; ++i)
+            {
+                const int p0 = triangles[i * POINTS_IN_FACE];
+                const int p1 = triangles[(i * POINTS_IN_FACE) + 1];
+                const int p2 = triangles[(i * POINTS_IN_FACE) + 2];
+
+                const D3DXVECTOR3& position = particles.positions[p0];
+                const D3DXVECTOR3 edge1(particles.positions[p1] - position);
+                const D3DXVECTOR3 edge2(particles.positions[p2] - position);
+                const D3DXVECTOR3 air((m_relative[p0] + m_relative[p1] + m_relative[p2]) * (1.0f / 3.0f));
+
+                // The cross product has a length of twice the triangle area
+                D3DXVECTOR3 normal;
+                D3DXVec3Cross(&normal, &edge1, &edge2);
+                const float doubleArea = D3DXVec3Length(&normal);
+                const float airSpeed = D3DXVec3Length(&air);
+                if(doubleArea == 0.0f || airSpeed == 0.0f)
+                {
+                    MakeZeroVector(m_triangleForces[i]);
+                    continue;
+                }
+                normal /= doubleArea;
+
+                // Drag pushes along the normal and lift acts across the flow; 
+                // both flip with the normal so the winding does not matter
+                const float normalSpeed = D3DXVec3Dot(&normal, &air);
+                D3DXVECTOR3 across, lift;
+                D3DXVec3Cross(&across, &normal, &air);
+                D3DXVec3Cross(&lift, &air, &across);
+
+                const D3DXVECTOR3 drag(normal * (DRAG_COEFFICIENT * airSpeed * normalSpeed));
+                lift *= LIFT_COEFFICIENT * normalSpeed / airSpeed;
+
+                m_triangleForces[i] = (drag + lift) * (forceScale * doubleArea * 0.5f);
+            }
+        });
+
+    // Each particle gathers from its own triangles so no writes are shared
+    pool.ParallelFor(static_cast<int>(m_relative.size()), PARTICLE_GRAIN,
+        [this, &particles, &particleTriangles, scale](int begin, int end)
+        {
+            for(int i = begin; i < end; ++i)
+            {
+                if(particles.flags[i] & ParticleData::STATIC)
+                {
+                    continue;
+                }
+
+                D3DXVECTOR3 force(0.0f, 0.0f, 0.0f);
+                for(int triangle : particleTriangles[i])
+                {
+                    force += m_triangleForces[triangle];
+                }
+                particles.accelerations[i] += force * (particles.inverseMasses[i] * scale);
+            }
+        });
+}
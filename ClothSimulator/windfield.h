@@ -0,0 +1,64 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - windfield.h
+////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include "common.h"
+
+struct ParticleData;
+class ThreadPool;
+
+/**
+* Gusting wind with turbulence that pushes on each triangle of the cloth.
+* Drag acts along the triangle normal and lift across the flow, both from the
+* velocity of the air relative to the triangle. Forces are found for every
+* triangle first and then gathered by each particle from its own triangles
+* so no two threads ever write to the same particle.
+*/
+class WindField
+{
+public:
+
+    /**
+    * Constructor
+    */
+    WindField();
+
+    /**
+    * Moves the wind forward in time and adds its force to the particles
+    * @param particles The particle data to push
+    * @param triangles The particle indices of each triangle
+    * @param particleTriangles The triangles using each particle
+    * @param pool The threads to evaluate the wind with
+    * @param deltatime The time passed since the last tick
+    * @param scale The amount to scale the force by
+    */
+    void Apply(ParticleData& particles, const std::vector<int>& triangles,
+        const std::vector<std::vector<int>>& particleTriangles,
+        ThreadPool& pool, float deltatime, float scale);
+
+    /**
+    * @param position The position in world coordinates
+    * @return the velocity of the air at the position
+    */
+    D3DXVECTOR3 GetVelocity(const D3DXVECTOR3& position) const;
+
+    /**
+    * @param velocity The average velocity of the wind
+    */
+    void SetVelocity(const D3DXVECTOR3& velocity);
+
+private:
+
+    /**
+    * Prevent copying
+    */
+    WindField(const WindField&);
+    WindField& operator=(const WindField&);
+
+    D3DXVECTOR3 m_velocity;                     ///< Average velocity of the wind
+    float m_time;                               ///< Time the wind has been blowing for
+    float m_gust;                               ///< Scale of the average velocity this tick
+    std::vector<D3DXVECTOR3> m_relative;        ///< Velocity of the air relative to each particle
+    std::vector<D3DXVECTOR3> m_triangleForces;  ///< Force each triangle gives to its particles
+};